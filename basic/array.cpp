@@ -1,208 +1,36 @@
 #include <iostream>
-#include <vector>
+#include "array.hpp"
 
-template <typename Array>
-struct array_iterator
+// CRC-32のテーブルをコンパイル時に作る
+constexpr std::uint32_t crc32_entry(size_t i)
 {
-    Array &a;
-    size_t i;
-
-    array_iterator(Array &a, size_t i) : a(a), i(i) {}
-
-    array_iterator &operator++()
-    {
-        ++i;
-        return *this;
-    }
-    array_iterator &operator--()
-    {
-        --i;
-        return *this;
-    }
-    array_iterator &operator++(int)
-    {
-        array_iterator copy = *this;
-        ++*this;
-        return copy;
-    }
-    array_iterator &operator--(int)
-    {
-        array_iterator copy = *this;
-        --*this;
-        return copy;
-    }
-    array_iterator &operator+=(std::size_t n)
-    {
-        i += n;
-        return *this;
-    }
-    array_iterator &operator-=(std::size_t n)
-    {
-        i -= n;
-        return *this;
-    }
-    array_iterator &operator+(std::size_t n) const
-    {
-        auto copy = *this;
-        copy += n;
-        return copy;
-    }
-    array_iterator &operator-(std::size_t n) const
-    {
-        auto copy = *this;
-        copy -= n;
-        return copy;
-    }
-
-    bool operator==(array_iterator const &right)
-    {
-        return i == right.i;
-    }
-    bool operator!=(array_iterator const &right)
-    {
-        return i != right.i;
-    }
-
-    typename Array::reference &operator*()
-    {
-        return a[i];
-    }
-    typename Array::reference operator[](size_t n)
-    {
-        return *(*this + n);
-    }
-};
-
-// array_iteratorの差異は
-// * メンバのArrayがconst修飾されている
-// * コンストラクタの引数のArrayもconst修飾されている
-// * 変換コンストラクタがあること
-// * *と[]がconst referenceを返すこと
-template <typename Array>
-struct array_const_iterator
-{
-    Array const &a;
-    size_t i;
-
-    array_const_iterator(Array const &a, size_t i) : a(a), i(i) {}
-    array_const_iterator(array_iterator<Array> const &iter) : a(iter.a), i(iter.i) {}
-
-    array_const_iterator &operator++()
-    {
-        ++i;
-        return *this;
-    }
-    array_const_iterator &operator--()
-    {
-        --i;
-        return *this;
-    }
-    array_const_iterator &operator++(int)
-    {
-        array_const_iterator copy = *this;
-        ++*this;
-        return copy;
-    }
-    array_const_iterator &operator--(int)
-    {
-        array_const_iterator copy = *this;
-        --*this;
-        return copy;
-    }
-    array_const_iterator &operator+=(std::size_t n)
-    {
-        i += n;
-        return *this;
-    }
-    array_const_iterator &operator-=(std::size_t n)
-    {
-        i -= n;
-        return *this;
-    }
-    array_const_iterator &operator+(std::size_t n) const
-    {
-        auto copy = *this;
-        copy += n;
-        return copy;
-    }
-    array_const_iterator &operator-(std::size_t n) const
-    {
-        auto copy = *this;
-        copy -= n;
-        return copy;
-    }
-
-    bool operator==(array_const_iterator const &right)
-    {
-        return i == right.i;
-    }
-    bool operator!=(array_const_iterator const &right)
-    {
-        return i != right.i;
-    }
-
-    typename Array::const_reference &operator*()
+    auto c = static_cast<std::uint32_t>(i);
+    for (int k = 0; k != 8; ++k)
     {
-        return a[i];
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
     }
-    typename Array::const_reference operator[](size_t n)
-    {
-        return *(*this + n);
-    }
-};
+    return c;
+}
+constexpr auto crc32_table = compile_time::make_table<std::uint32_t, 256>(crc32_entry);
 
-template <typename T, size_t N>
-struct array
+constexpr std::uint32_t crc32(std::string_view data)
 {
-    T storage[N];
-
-    using reference = T &;
-    using const_reference = T const &;
-    using iterator = array_iterator<array>;
-    using const_iterator = array_const_iterator<array>;
-
-    reference operator[](size_t i)
+    std::uint32_t c = 0xFFFFFFFFu;
+    for (unsigned char x : data)
     {
-        return storage[i];
+        c = crc32_table[(c ^ x) & 0xFF] ^ (c >> 8);
     }
+    return c ^ 0xFFFFFFFFu;
+}
+static_assert(crc32("123456789") == 0xCBF43926u);
 
-    const_reference operator[](size_t i) const
-    {
-        return storage[i];
-    }
+// キーワード表をコンパイル時にソートしておき、実行時は二分探索だけにする
+constexpr auto keywords = compile_time::sorted(array<std::string_view, 6>{"while", "if", "for", "return", "else", "do"});
+static_assert(keywords[0] == "do" && keywords[5] == "while");
+static_assert(std::binary_search(keywords.begin(), keywords.end(), std::string_view("return")));
+static_assert(!std::binary_search(keywords.begin(), keywords.end(), std::string_view("goto")));
 
-    iterator begin()
-    {
-        return array_iterator(*this, 0);
-    }
-
-    iterator end()
-    {
-        return array_iterator(*this, N);
-    }
-    const_iterator cbegin() const
-    {
-        return array_const_iterator(*this, 0);
-    }
-    const_iterator cend() const
-    {
-        return array_const_iterator(*this, N);
-    }
-    // const arrayの時にconst_iteratorを返す
-    // const修飾されたインスタンスからはconstなメンバ関数しか呼び出すことができない。
-    // constなメンバ関数はrefereceを返すのではなく、const referenceを返すべき
-    const_iterator begin() const
-    {
-        return array_const_iterator(*this, 0);
-    }
-    // const arrayの時にconst_iteratorを返す
-    const_iterator end() const
-    {
-        return array_const_iterator(*this, N);
-    }
-};
-
-int main()
+int main(int argc, char **argv)
 {
     array<int, 5> a = {1, 2, 3, 4, 5};
     std::for_each(std::begin(a), std::end(a), [](auto x)
@@ -218,4 +46,42 @@ int main()
     std::cout << *citer;
     ++citer;
     std::cout << *citer;
-}
\ No newline at end of file
+    std::cout << std::endl;
+
+    // contiguous iteratorなので、標準ライブラリ(libc++等)はstd::to_addressでポインタに戻してmemmoveを使える
+    array<int, 5> d;
+    std::copy(a.begin(), a.end(), d.begin());
+    std::cout << d[4] << ' ' << *(d.end() - 1) << ' ' << (d.end() - d.begin()) << std::endl;
+
+    // スタック上の固定長バッファ
+    static_vector<std::string, 4> names = {"a", "b"};
+    names.push_back("c");
+    names.emplace_back(3, 'd');
+    names.pop_back();
+    std::cout << names.size() << ' ' << names.back() << std::endl;
+    // 容量を超える初期化子は、要素を1つも構築せずに例外になる
+    try
+    {
+        static_vector<std::string, 2> overflow = {std::string(32, 'x'), std::string(32, 'y'), std::string(32, 'z')};
+    }
+    catch (const std::length_error &e)
+    {
+        std::cout << e.what() << std::endl;
+    }
+
+    static_vector<int, 8> buf;
+    for (auto x : a)
+    {
+        buf.push_back(x * 10);
+    }
+    std::sort(buf.begin(), buf.end(), std::greater<>());
+    std::for_each(buf.begin(), buf.end(), [](auto x)
+                  { std::cout << x << ' '; });
+    std::cout << std::endl;
+
+    std::cout << std::hex << crc32("hello") << std::dec << std::endl;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::cout << argv[i] << ": " << (std::binary_search(keywords.begin(), keywords.end(), std::string_view(argv[i])) ? "keyword" : "identifier") << std::endl;
+    }
+}
@@ -0,0 +1,514 @@
+#ifndef ARRAY_HPP
+#define ARRAY_HPP
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ポインタを1つだけ持つイテレータ
+// 以前はArray &とindexを持っていたが、それだとstd::copy等がmemmoveを使う高速なパスに入れない
+// iterator_conceptをcontiguous_iterator_tagにし、operator->を用意してstd::to_addressで生ポインタを取り出せるようにしている
+template <typename Array>
+struct array_iterator
+{
+    using iterator_concept = std::contiguous_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename Array::value_type;
+    using element_type = value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type *;
+    using reference = value_type &;
+
+    pointer p = nullptr;
+
+    constexpr array_iterator() = default;
+    constexpr explicit array_iterator(pointer p) : p(p) {}
+
+    constexpr array_iterator &operator++()
+    {
+        ++p;
+        return *this;
+    }
+    constexpr array_iterator &operator--()
+    {
+        --p;
+        return *this;
+    }
+    // 後置は変更前のコピーを値で返す。参照を返すとローカル変数の参照になってしまう
+    constexpr array_iterator operator++(int)
+    {
+        array_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+    constexpr array_iterator operator--(int)
+    {
+        array_iterator copy = *this;
+        --*this;
+        return copy;
+    }
+    constexpr array_iterator &operator+=(difference_type n)
+    {
+        p += n;
+        return *this;
+    }
+    constexpr array_iterator &operator-=(difference_type n)
+    {
+        p -= n;
+        return *this;
+    }
+    constexpr array_iterator operator+(difference_type n) const
+    {
+        auto copy = *this;
+        copy += n;
+        return copy;
+    }
+    friend constexpr array_iterator operator+(difference_type n, const array_iterator &iter)
+    {
+        return iter + n;
+    }
+    constexpr array_iterator operator-(difference_type n) const
+    {
+        auto copy = *this;
+        copy -= n;
+        return copy;
+    }
+    constexpr difference_type operator-(const array_iterator &right) const
+    {
+        return p - right.p;
+    }
+
+    constexpr bool operator==(const array_iterator &right) const
+    {
+        return p == right.p;
+    }
+    constexpr auto operator<=>(const array_iterator &right) const
+    {
+        return p <=> right.p;
+    }
+
+    constexpr reference operator*() const
+    {
+        return *p;
+    }
+    constexpr pointer operator->() const
+    {
+        return p;
+    }
+    constexpr reference operator[](difference_type n) const
+    {
+        return p[n];
+    }
+};
+
+// array_iteratorの差異は
+// * 持っているポインタがconst修飾されている
+// * 変換コンストラクタがあること
+// * *と[]がconst referenceを返すこと
+template <typename Array>
+struct array_const_iterator
+{
+    using iterator_concept = std::contiguous_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename Array::value_type;
+    using element_type = const value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+
+    pointer p = nullptr;
+
+    constexpr array_const_iterator() = default;
+    constexpr explicit array_const_iterator(pointer p) : p(p) {}
+    constexpr array_const_iterator(const array_iterator<Array> &iter) : p(iter.p) {}
+
+    constexpr array_const_iterator &operator++()
+    {
+        ++p;
+        return *this;
+    }
+    constexpr array_const_iterator &operator--()
+    {
+        --p;
+        return *this;
+    }
+    constexpr array_const_iterator operator++(int)
+    {
+        array_const_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+    constexpr array_const_iterator operator--(int)
+    {
+        array_const_iterator copy = *this;
+        --*this;
+        return copy;
+    }
+    constexpr array_const_iterator &operator+=(difference_type n)
+    {
+        p += n;
+        return *this;
+    }
+    constexpr array_const_iterator &operator-=(difference_type n)
+    {
+        p -= n;
+        return *this;
+    }
+    constexpr array_const_iterator operator+(difference_type n) const
+    {
+        auto copy = *this;
+        copy += n;
+        return copy;
+    }
+    friend constexpr array_const_iterator operator+(difference_type n, const array_const_iterator &iter)
+    {
+        return iter + n;
+    }
+    constexpr array_const_iterator operator-(difference_type n) const
+    {
+        auto copy = *this;
+        copy -= n;
+        return copy;
+    }
+    constexpr difference_type operator-(const array_const_iterator &right) const
+    {
+        return p - right.p;
+    }
+
+    constexpr bool operator==(const array_const_iterator &right) const
+    {
+        return p == right.p;
+    }
+    constexpr auto operator<=>(const array_const_iterator &right) const
+    {
+        return p <=> right.p;
+    }
+
+    constexpr reference operator*() const
+    {
+        return *p;
+    }
+    constexpr pointer operator->() const
+    {
+        return p;
+    }
+    constexpr reference operator[](difference_type n) const
+    {
+        return p[n];
+    }
+};
+
+template <typename T, size_t N>
+struct array
+{
+    T storage[N];
+
+    using value_type = T;
+    using pointer = T *;
+    using const_pointer = T const *;
+    using reference = T &;
+    using const_reference = T const &;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using iterator = array_iterator<array>;
+    using const_iterator = array_const_iterator<array>;
+
+    constexpr reference operator[](size_t i)
+    {
+        return storage[i];
+    }
+
+    constexpr const_reference operator[](size_t i) const
+    {
+        return storage[i];
+    }
+
+    constexpr pointer data()
+    {
+        return storage;
+    }
+    constexpr const_pointer data() const
+    {
+        return storage;
+    }
+    constexpr size_type size() const
+    {
+        return N;
+    }
+
+    constexpr iterator begin()
+    {
+        return iterator(storage);
+    }
+
+    constexpr iterator end()
+    {
+        return iterator(storage + N);
+    }
+    constexpr const_iterator cbegin() const
+    {
+        return const_iterator(storage);
+    }
+    constexpr const_iterator cend() const
+    {
+        return const_iterator(storage + N);
+    }
+    // const arrayの時にconst_iteratorを返す
+    // const修飾されたインスタンスからはconstなメンバ関数しか呼び出すことができない。
+    // constなメンバ関数はrefereceを返すのではなく、const referenceを返すべき
+    constexpr const_iterator begin() const
+    {
+        return const_iterator(storage);
+    }
+    // const arrayの時にconst_iteratorを返す
+    constexpr const_iterator end() const
+    {
+        return const_iterator(storage + N);
+    }
+};
+
+// 容量Nが固定で、ヒープを一切使わないvector
+// arrayと同じくstorage[N]をオブジェクト内に持つが、要素はpush_backした分だけ構築する
+// そのためstorageを無名unionに入れて、コンストラクタで初期化されないようにしている
+template <typename T, size_t N>
+class static_vector
+{
+public:
+    using value_type = T;
+    using pointer = T *;
+    using const_pointer = T const *;
+    using reference = T &;
+    using const_reference = T const &;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using iterator = array_iterator<static_vector>;
+    using const_iterator = array_const_iterator<static_vector>;
+
+    static_vector() {}
+    // 以下のコンストラクタはデフォルトコンストラクタに委譲しておく
+    // 委譲先が終わった時点でオブジェクトは構築済みになるので、途中で例外が出てもデストラクタが構築済みの要素を破棄する
+    static_vector(std::initializer_list<T> init) : static_vector()
+    {
+        if (init.size() > N)
+        {
+            throw std::length_error("static_vector: too many initializers.");
+        }
+        for (auto &x : init)
+        {
+            push_back(x);
+        }
+    }
+    static_vector(const static_vector &r) : static_vector()
+    {
+        for (auto &x : r)
+        {
+            push_back(x);
+        }
+    }
+    static_vector &operator=(const static_vector &r)
+    {
+        if (this != &r)
+        {
+            clear();
+            for (auto &x : r)
+            {
+                push_back(x);
+            }
+        }
+        return *this;
+    }
+    // 要素はオブジェクトの中にあるので、moveしても要素ごとのmoveになる
+    static_vector(static_vector &&r) noexcept(std::is_nothrow_move_constructible_v<T>) : static_vector()
+    {
+        for (auto &x : r)
+        {
+            push_back(std::move(x));
+        }
+    }
+    static_vector &operator=(static_vector &&r) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        if (this != &r)
+        {
+            clear();
+            for (auto &x : r)
+            {
+                push_back(std::move(x));
+            }
+        }
+        return *this;
+    }
+    ~static_vector()
+    {
+        clear();
+    }
+
+    // 容量を超えた場合は例外を投げる。ヒープにフォールバックはしない
+    void push_back(const_reference value)
+    {
+        emplace_back(value);
+    }
+    void push_back(value_type &&value)
+    {
+        emplace_back(std::move(value));
+    }
+    template <typename... Args>
+    reference emplace_back(Args &&...args)
+    {
+        if (count == N)
+        {
+            throw std::length_error("static_vector is full.");
+        }
+        auto p = std::construct_at(storage + count, std::forward<Args>(args)...);
+        ++count;
+        return *p;
+    }
+    void pop_back()
+    {
+        --count;
+        std::destroy_at(storage + count);
+    }
+    void clear() noexcept
+    {
+        while (count != 0)
+        {
+            pop_back();
+        }
+    }
+
+    reference operator[](size_t i)
+    {
+        return storage[i];
+    }
+    const_reference operator[](size_t i) const
+    {
+        return storage[i];
+    }
+    reference at(size_t i)
+    {
+        if (i >= count)
+        {
+            throw std::out_of_range("index is out of range.");
+        }
+        return storage[i];
+    }
+    const_reference at(size_t i) const
+    {
+        if (i >= count)
+        {
+            throw std::out_of_range("index is out of range.");
+        }
+        return storage[i];
+    }
+    reference front()
+    {
+        return storage[0];
+    }
+    const_reference front() const
+    {
+        return storage[0];
+    }
+    reference back()
+    {
+        return storage[count - 1];
+    }
+    const_reference back() const
+    {
+        return storage[count - 1];
+    }
+    pointer data()
+    {
+        return storage;
+    }
+    const_pointer data() const
+    {
+        return storage;
+    }
+
+    size_type size() const
+    {
+        return count;
+    }
+    static constexpr size_type capacity()
+    {
+        return N;
+    }
+    bool empty() const
+    {
+        return count == 0;
+    }
+    bool full() const
+    {
+        return count == N;
+    }
+
+    iterator begin()
+    {
+        return iterator(storage);
+    }
+    iterator end()
+    {
+        return iterator(storage + count);
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(storage);
+    }
+    const_iterator end() const
+    {
+        return const_iterator(storage + count);
+    }
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+    const_iterator cend() const
+    {
+        return end();
+    }
+
+private:
+    union
+    {
+        T storage[N];
+    };
+    size_type count = 0;
+};
+
+static_assert(std::contiguous_iterator<array<int, 5>::iterator>);
+static_assert(std::contiguous_iterator<array<int, 5>::const_iterator>);
+static_assert(std::contiguous_iterator<static_vector<int, 5>::iterator>);
+
+// コンパイル時のテーブル生成
+// arrayとイテレータが全てconstexprなので、constexpr変数の初期化の中で使える
+// C++20ではstd::sort/std::lower_bound/std::binary_searchもconstexprなので、探索やソートはそれをそのまま使う
+// 結果をconstexprなグローバル変数に入れれば、起動時の計算はなくなり.rodataに置かれる
+namespace compile_time
+{
+    // table[i] = f(i) となるarrayを作る
+    template <typename T, size_t N, typename F>
+    constexpr array<T, N> make_table(F f)
+    {
+        array<T, N> table{};
+        for (size_t i = 0; i != N; ++i)
+        {
+            table[i] = f(i);
+        }
+        return table;
+    }
+
+    // ソート済みのコピーを返す
+    template <typename T, size_t N, typename Compare = std::less<>>
+    constexpr array<T, N> sorted(array<T, N> a, Compare comp = Compare())
+    {
+        std::sort(a.begin(), a.end(), comp);
+        return a;
+    }
+}
+
+#endif
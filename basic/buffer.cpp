@@ -0,0 +1,121 @@
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h> // pread
+#include "buffer.hpp"
+#include "../lockfree/sharded_queue.hpp"
+
+// 長さ(1byte)とデータからなるフレームが連なった受信データを、コピーせずにフレームごとのsliceに分ける
+std::vector<slice> split_frames(slice received)
+{
+    std::vector<slice> frames;
+    while (!received.empty())
+    {
+        auto n = static_cast<std::size_t>(received.data()[0]);
+        received.remove_prefix(1);
+        frames.push_back(received.take_front(n));
+    }
+    return frames;
+}
+
+int main()
+{
+    chunk_pool pool(4096);
+    {
+        buffer_writer writer(pool);
+        // recvの代わり。prepareした領域に直接書き込み、書いた分だけcommitする
+        std::string wire = "\x05hello\x01,\x06 world\x01!";
+        auto area = writer.prepare(wire.size());
+        std::memcpy(area.data(), wire.data(), wire.size());
+        auto received = writer.commit(wire.size());
+
+        auto frames = split_frames(received);
+        slice_chain chain;
+        for (auto &f : frames)
+        {
+            chain.append(f);
+        }
+        // 全てのsliceが受信したchunkの中を指している
+        bool shared = true;
+        for (auto &f : frames)
+        {
+            shared = shared && f.get_chunk() == received.get_chunk();
+        }
+        // hello, world! 4 1
+        std::cout << chain.flatten() << ' ' << chain.slice_count() << ' ' << shared << std::endl;
+
+        // writevで書き出す。途中までしか書けなかった時のためにconsumeがある
+        auto file = std::tmpfile();
+        auto fd = fileno(file);
+        auto written = chain.write_to(fd);
+        char back[64] = {};
+        auto n = pread(fd, back, sizeof(back), 0);
+        std::fclose(file);
+        std::cout << written << ' ' << std::string_view(back, static_cast<std::size_t>(n)) << ' ' << chain.empty() << std::endl;
+
+        // received, writerと4つのframeがchunkを指している(chainは書き出した分を手放している)
+        // ペイロードの先頭はキャッシュラインの境界
+        std::cout << "refs: " << received.get_chunk()->use_count() << " payload offset mod 64: "
+                  << reinterpret_cast<std::uintptr_t>(received.get_chunk()->data()) % 64 << std::endl;
+    }
+    // 全てのsliceを手放したのでchunkはプールに戻っている
+    std::cout << "created: " << pool.chunks_created() << " outstanding: " << pool.chunks_outstanding() << std::endl;
+
+    {
+        // 2つの生産者が1500byteのパケットをlockfree::sharded_queueで1つの消費者に渡す(生産者はそれぞれlaneを1本占有する)
+        // std::stringで渡すと、積む時と取り出す時に1500byteずつコピーする。sliceなら参照カウントの増減だけ
+        constexpr int per_producer = 100000;
+        const std::string payload(1500, 'p');
+
+        // make_producerは生産者スレッドごとに1回呼ばれ、パケットを作る関数を返す
+        auto run = [&](auto make_producer, auto consume)
+        {
+            using value = decltype(make_producer()(0));
+            lockfree::sharded_queue<value> q(2);
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> producers;
+            for (int p = 0; p != 2; ++p)
+            {
+                producers.emplace_back([&]
+                                       {
+                                           auto make = make_producer();
+                                           for (int i = 0; i != per_producer; ++i)
+                                           {
+                                               q.enq(make(i));
+                                           } });
+            }
+            std::size_t bytes = 0;
+            for (int i = 0; i != 2 * per_producer; ++i)
+            {
+                bytes += consume(q.deq());
+            }
+            for (auto &t : producers)
+            {
+                t.join();
+            }
+            auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            return std::pair(ns / (2 * per_producer), bytes);
+        };
+
+        auto [string_ns, string_bytes] = run([&]
+                                             { return [&](int)
+                                                      { return payload; }; },
+                                             [](const std::string &s)
+                                             { return s.size(); });
+        // 受信したデータをsliceにするところまでは生産者の仕事(ここで1回だけコピーする)
+        chunk_pool packets(64 * 1024);
+        auto [slice_ns, slice_bytes] = run([&]
+                                           { return [&, writer = std::make_shared<buffer_writer>(packets)](int)
+                                                    { return writer->write(payload); }; },
+                                           [](const slice &s)
+                                           { return s.size(); });
+        std::cout << "std::string: " << string_ns << " ns/packet, slice: " << slice_ns << " ns/packet, "
+                  << (string_bytes == slice_bytes) << ' ' << packets.chunks_created() << " chunks, "
+                  << packets.chunks_outstanding() << " outstanding" << std::endl;
+    }
+}
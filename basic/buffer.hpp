@@ -0,0 +1,340 @@
+#ifndef BUFFER_HPP
+#define BUFFER_HPP
+
+#include <sys/uio.h> // iovec, writev
+#include <algorithm>
+#include <climits> // IOV_MAX
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "smart_pointer.hpp"
+#include "../lockfree/stack.hpp"
+
+// ペイロードをコピーせずに分割・転送するためのバッファ
+// * chunk: プールから借りる大きな領域(既定64KB)。参照カウントを先頭に埋め込み、0になったらプールに返る
+// * slice: chunkの一部を指す(chunkへのintrusive_ptr, offset, length)。コピーは参照カウントの増減だけで、バイト列には触れない
+//   subsliceでさらに切り出せる。受信したバッファをフレームごとに切り分けたり、ヘッダとボディに分けたりできる
+// * slice_chain: sliceを並べたもの。iovecに変換してwritevにそのまま渡せる(scatter/gather)
+// * buffer_writer: chunkの先頭から順に領域を切り出す。1つのchunkから多数のsliceを作るので、確保は1chunkに1回
+//
+// sliceはlockfree::queueにそのまま積める。nodeに入るのはsliceだけで、ペイロードはコピーされない
+// sliceが指すバイト列は、buffer_writerがcommitした後は書き換えないこと(他のsliceやスレッドと共有されている)
+class chunk_pool;
+
+// ヘッダの直後にペイロードを置く。ヘッダを1キャッシュライン分にして、ペイロードがキャッシュラインの境界から始まるようにする
+class alignas(64) chunk
+{
+public:
+    std::size_t capacity() const noexcept { return size; }
+    std::byte *data() noexcept { return reinterpret_cast<std::byte *>(this + 1); }
+    const std::byte *data() const noexcept { return reinterpret_cast<const std::byte *>(this + 1); }
+    std::uint32_t use_count() const noexcept { return refs.load(std::memory_order_relaxed); }
+
+private:
+    friend class chunk_pool;
+
+    std::atomic<std::uint32_t> refs{0};
+    std::size_t size;
+    // nullptrならプールに返さずに解放する(プールのchunkより大きな領域)
+    chunk_pool *pool;
+    chunk *next_free = nullptr;
+
+    chunk(std::size_t size, chunk_pool *pool) noexcept : size(size), pool(pool) {}
+
+    static constexpr std::align_val_t alignment{64};
+    static chunk *create(std::size_t size, chunk_pool *pool)
+    {
+        auto p = ::operator new(sizeof(chunk) + size, alignment);
+        return ::new (p) chunk(size, pool);
+    }
+    static void destroy(chunk *c) noexcept
+    {
+        c->~chunk();
+        ::operator delete(c, alignment);
+    }
+
+    friend void intrusive_ptr_add_ref(chunk *c) noexcept
+    {
+        c->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    friend void intrusive_ptr_release(chunk *c) noexcept;
+};
+static_assert(sizeof(chunk) == 64 && alignof(chunk) == 64);
+
+// 同じ大きさのchunkを使い回す
+// 空きchunkはatomic_recycling_stackに積むので、どのスレッドから返しても、借りてもロックを取らない
+// プールは、借りたchunk(を指すslice)が全て返るまで破棄しないこと
+class chunk_pool
+{
+public:
+    explicit chunk_pool(std::size_t chunk_size = 64 * 1024) : chunk_size(chunk_size) {}
+    ~chunk_pool()
+    {
+        while (auto c = free_chunks.pop())
+        {
+            chunk::destroy(c);
+        }
+    }
+    chunk_pool(const chunk_pool &) = delete;
+    chunk_pool &operator=(const chunk_pool &) = delete;
+
+    static chunk_pool &instance()
+    {
+        static chunk_pool pool;
+        return pool;
+    }
+
+    // sizeがchunk_sizeより大きければ、プールを通さずにその大きさで確保する
+    intrusive_ptr<chunk> acquire(std::size_t size = 0)
+    {
+        // sliceはoffsetと長さを32bitで持つ
+        if (size > UINT32_MAX)
+        {
+            throw std::length_error("chunk_pool: chunk is too large.");
+        }
+        if (size > chunk_size)
+        {
+            return intrusive_ptr<chunk>(chunk::create(size, nullptr));
+        }
+        auto c = free_chunks.pop();
+        if (c == nullptr)
+        {
+            c = chunk::create(chunk_size, this);
+            created.fetch_add(1, std::memory_order_relaxed);
+        }
+        outstanding.fetch_add(1, std::memory_order_relaxed);
+        return intrusive_ptr<chunk>(c);
+    }
+
+    std::size_t chunk_capacity() const noexcept { return chunk_size; }
+    // これまでに確保したchunkの数と、今貸している数
+    std::size_t chunks_created() const noexcept { return created.load(std::memory_order_relaxed); }
+    std::size_t chunks_outstanding() const noexcept { return outstanding.load(std::memory_order_relaxed); }
+
+private:
+    friend void intrusive_ptr_release(chunk *c) noexcept;
+
+    std::size_t chunk_size;
+    atomic_recycling_stack<chunk, &chunk::next_free> free_chunks{};
+    std::atomic<std::size_t> created{0};
+    std::atomic<std::size_t> outstanding{0};
+
+    void recycle(chunk *c) noexcept
+    {
+        outstanding.fetch_sub(1, std::memory_order_relaxed);
+        free_chunks.push(c);
+    }
+};
+
+inline void intrusive_ptr_release(chunk *c) noexcept
+{
+    // 最後の参照を手放したスレッドが、他のスレッドでの書き込みを全て見てから返す
+    if (c->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        if (c->pool != nullptr)
+        {
+            c->pool->recycle(c);
+        }
+        else
+        {
+            chunk::destroy(c);
+        }
+    }
+}
+
+class slice
+{
+public:
+    slice() = default;
+    slice(intrusive_ptr<chunk> owner, std::size_t offset, std::size_t length) noexcept
+        : owner(std::move(owner)), offset(static_cast<std::uint32_t>(offset)), length(static_cast<std::uint32_t>(length))
+    {
+    }
+
+    const std::byte *data() const noexcept { return owner ? owner->data() + offset : nullptr; }
+    std::size_t size() const noexcept { return length; }
+    bool empty() const noexcept { return length == 0; }
+    std::string_view view() const noexcept
+    {
+        return {reinterpret_cast<const char *>(data()), length};
+    }
+    std::span<const std::byte> bytes() const noexcept { return {data(), length}; }
+    const chunk *get_chunk() const noexcept { return owner.get(); }
+
+    // [pos, pos + n)を指すslice。nを省略すると末尾まで
+    slice subslice(std::size_t pos, std::size_t n = std::string_view::npos) const
+    {
+        if (pos > length)
+        {
+            throw std::out_of_range("slice: position is out of range.");
+        }
+        n = std::min<std::size_t>(n, length - pos);
+        return slice(owner, offset + pos, n);
+    }
+    // 先頭n byteを切り離して返し、自分は残りを指す
+    slice take_front(std::size_t n)
+    {
+        auto front = subslice(0, n);
+        offset += static_cast<std::uint32_t>(front.size());
+        length -= static_cast<std::uint32_t>(front.size());
+        return front;
+    }
+    void remove_prefix(std::size_t n)
+    {
+        take_front(n);
+    }
+
+private:
+    intrusive_ptr<chunk> owner;
+    std::uint32_t offset = 0;
+    std::uint32_t length = 0;
+};
+
+// scatter/gatherのためのsliceの列
+class slice_chain
+{
+public:
+    void append(slice s)
+    {
+        if (!s.empty())
+        {
+            total += s.size();
+            slices.push_back(std::move(s));
+        }
+    }
+    std::size_t size() const noexcept { return total; }
+    bool empty() const noexcept { return total == 0; }
+    std::size_t slice_count() const noexcept { return slices.size() - first; }
+
+    // writevに渡す配列。sliceを足したり消費したりすると無効になる
+    const std::vector<iovec> &iovecs()
+    {
+        vecs.clear();
+        for (auto i = first; i != slices.size(); ++i)
+        {
+            vecs.push_back({const_cast<std::byte *>(slices[i].data()), slices[i].size()});
+        }
+        return vecs;
+    }
+    // 先頭からn byteを書き出し済みとして捨てる(writevが途中までしか書けなかった場合)
+    void consume(std::size_t n)
+    {
+        n = std::min(n, total);
+        total -= n;
+        while (n != 0)
+        {
+            auto &s = slices[first];
+            auto k = std::min(n, s.size());
+            s.remove_prefix(k);
+            n -= k;
+            if (s.empty())
+            {
+                s = slice();
+                ++first;
+            }
+        }
+        if (first == slices.size())
+        {
+            clear();
+        }
+    }
+    void clear() noexcept
+    {
+        slices.clear();
+        first = 0;
+        total = 0;
+    }
+    // 全てを書き出すまでwritevを繰り返す。失敗したら-1(errnoはwritevのもの)
+    // IOV_MAXを超える数のsliceは、何回かに分けて書く
+    ssize_t write_to(int fd)
+    {
+        ssize_t written = 0;
+        while (!empty())
+        {
+            auto &v = iovecs();
+            auto n = ::writev(fd, v.data(), static_cast<int>(std::min<std::size_t>(v.size(), IOV_MAX)));
+            if (n < 0)
+            {
+                return -1;
+            }
+            consume(static_cast<std::size_t>(n));
+            written += n;
+        }
+        return written;
+    }
+    // 1つの連続した文字列にコピーする(確認用)
+    std::string flatten() const
+    {
+        std::string s;
+        s.reserve(total);
+        for (auto i = first; i != slices.size(); ++i)
+        {
+            s += slices[i].view();
+        }
+        return s;
+    }
+
+private:
+    std::vector<slice> slices;
+    // consumeで捨てた分。先頭から消すたびにvectorを詰めないよう、位置だけずらす
+    std::size_t first = 0;
+    std::size_t total = 0;
+    std::vector<iovec> vecs;
+};
+
+// chunkの先頭から順に領域を切り出してsliceにする。1つのスレッドから使う
+//   auto area = writer.prepare(4096);   // 書き込める領域
+//   auto n = read(fd, area.data(), area.size());
+//   slice received = writer.commit(n);  // 書いた分だけをsliceにする
+class buffer_writer
+{
+public:
+    explicit buffer_writer(chunk_pool &pool = chunk_pool::instance()) : pool(pool) {}
+
+    // 少なくともn byte書き込める領域。今のchunkに入らなければ新しいchunkを借りる
+    std::span<std::byte> prepare(std::size_t n)
+    {
+        if (!current || current->capacity() - used < n)
+        {
+            current = pool.acquire(n);
+            used = 0;
+        }
+        return {current->data() + used, current->capacity() - used};
+    }
+    // prepareした領域の先頭n byteをsliceにする
+    slice commit(std::size_t n)
+    {
+        if (!current || current->capacity() - used < n)
+        {
+            throw std::length_error("buffer_writer: commit exceeds the prepared area.");
+        }
+        slice s(current, used, n);
+        used += n;
+        return s;
+    }
+    // コピーしてsliceにする。コピーはここで1回だけ
+    slice write(const void *p, std::size_t n)
+    {
+        std::memcpy(prepare(n).data(), p, n);
+        return commit(n);
+    }
+    slice write(std::string_view s)
+    {
+        return write(s.data(), s.size());
+    }
+
+private:
+    chunk_pool &pool;
+    intrusive_ptr<chunk> current;
+    std::size_t used = 0;
+};
+
+#endif
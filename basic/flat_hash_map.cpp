@@ -0,0 +1,125 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "flat_hash_map.hpp"
+#include "my_vector.hpp"
+
+// std::stringのキーをstring_viewやconst char *のまま探せるようにするハッシュ
+struct string_hash
+{
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept
+    {
+        return std::hash<std::string_view>()(s);
+    }
+};
+
+// 1回の検索にかかる時間(ns)
+template <typename Map>
+double lookup_ns(const Map &m, const std::vector<std::uint64_t> &keys)
+{
+    std::size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round != 5; ++round)
+    {
+        for (auto k : keys)
+        {
+            found += m.find(k) != m.end();
+        }
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    // 半分は存在するキー
+    if (found != keys.size() / 2 * 5)
+    {
+        std::cout << "unexpected: " << found << std::endl;
+    }
+    return ns / static_cast<double>(keys.size() * 5);
+}
+
+int main()
+{
+    {
+        flat_hash_map<std::string, int, string_hash, std::equal_to<>> ages{{"alice", 30}, {"bob", 25}};
+        ages["carol"] = 41;
+        ages.try_emplace("bob", 99);
+        ages.insert_or_assign("alice", 31);
+        // string_viewのまま探す(std::stringを作らない)
+        std::string_view name = "carol";
+        std::cout << ages.at(name) << ' ' << ages.at("alice") << ' ' << ages["bob"] << ' ' << ages.contains(std::string_view("dave")) << std::endl;
+        ages.erase("bob");
+        for (auto &[k, v] : ages)
+        {
+            std::cout << k << ':' << v << ' ';
+        }
+        std::cout << ages.size() << std::endl;
+    }
+    {
+        // unordered_mapと同じ操作を乱数で繰り返し、中身が一致し続けるか確かめる
+        // キーの範囲を狭くして、削除済みスロットの再利用と、同じ大きさでの片付けも起こす
+        flat_hash_map<int, int> flat;
+        std::unordered_map<int, int> reference;
+        std::mt19937 rng(1);
+        bool same = true;
+        for (int i = 0; i != 1000000; ++i)
+        {
+            int key = static_cast<int>(rng() % 5000);
+            switch (rng() % 3)
+            {
+            case 0:
+                flat[key] = i;
+                reference[key] = i;
+                break;
+            case 1:
+                same = same && flat.erase(key) == reference.erase(key);
+                break;
+            default:
+            {
+                auto it = flat.find(key);
+                auto jt = reference.find(key);
+                same = same && (it == flat.end()) == (jt == reference.end()) && (it == flat.end() || it->second == jt->second);
+            }
+            }
+        }
+        same = same && flat.size() == reference.size();
+        for (auto &[k, v] : flat)
+        {
+            same = same && reference.at(k) == v;
+        }
+        auto copy = flat;
+        copy.rehash(0);
+        std::cout << same << ' ' << flat.size() << ' ' << flat.capacity() << ' ' << copy.capacity() << ' ' << (copy.size() == flat.size()) << std::endl;
+    }
+    {
+        // 100万要素での検索と、確保したメモリの比較
+        constexpr std::size_t n = 1000000;
+        std::mt19937_64 rng(2);
+        std::vector<std::uint64_t> keys(2 * n);
+        for (auto &k : keys)
+        {
+            k = rng();
+        }
+        using value = std::pair<const std::uint64_t, std::uint64_t>;
+        flat_hash_map<std::uint64_t, std::uint64_t, std::hash<std::uint64_t>, std::equal_to<std::uint64_t>, tracking_allocator<value>> flat(
+            tracking_allocator<value>("flat_hash_map"));
+        std::unordered_map<std::uint64_t, std::uint64_t, std::hash<std::uint64_t>, std::equal_to<std::uint64_t>, tracking_allocator<value>> node(
+            0, std::hash<std::uint64_t>(), std::equal_to<std::uint64_t>(), tracking_allocator<value>("unordered_map"));
+        for (std::size_t i = 0; i != n; ++i)
+        {
+            flat.try_emplace(keys[i], i);
+            node.try_emplace(keys[i], i);
+        }
+        std::shuffle(keys.begin(), keys.end(), rng);
+        auto flat_ns = lookup_ns(flat, keys);
+        auto node_ns = lookup_ns(node, keys);
+        auto &flat_stats = flat.get_allocator().statistics();
+        auto &node_stats = node.get_allocator().statistics();
+        std::cout << "flat_hash_map: " << flat_ns << " ns/find, " << flat_stats.live_bytes / (1 << 20) << " MiB, "
+                  << flat_stats.allocations << " allocations, " << flat_stats.grows << " rehashes" << std::endl;
+        std::cout << "unordered_map: " << node_ns << " ns/find, " << node_stats.live_bytes / (1 << 20) << " MiB, "
+                  << node_stats.allocations << " allocations" << std::endl;
+    }
+}
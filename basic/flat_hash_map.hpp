@@ -0,0 +1,637 @@
+#ifndef FLAT_HASH_MAP_HPP
+#define FLAT_HASH_MAP_HPP
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../trace/trace.hpp"
+
+// オープンアドレス法のハッシュマップ(Swiss table)
+// https://abseil.io/about/design/swisstables
+// std::unordered_mapは要素ごとにノードを確保し、検索のたびにポインタをたどる
+// flat_hash_mapは要素をスロットの配列に直接並べ、スロットごとに1byteの制御バイトを別の配列に持つ
+// * 制御バイトは空(empty)、削除済み(deleted)、または使用中ならハッシュの下位7bit(h2)
+// * 検索はハッシュの残り(h1)で16スロットのグループを選び、グループの制御バイト16個とh2をSSE2で一度に比べる
+//   一致したスロットだけキーを比べるので、キーの比較はほとんどの場合1回で済む
+//   グループに空きが1つでもあれば、そこで探索を終える(それより先に置かれたキーはない)
+// * 要素数がスロット数の7/8に達したら2倍に広げる
+// * 確保はvectorと同じくallocator_traitsを通し、アロケータがon_reallocateを持っていれば再ハッシュを通知する
+// * Hashとキーの比較がどちらもis_transparentを持っていれば、find等にKey以外の型(string_viewなど)をそのまま渡せる
+//
+// 要素はvalue_type(pair<const Key, T>)のまま置くので、再ハッシュではキーはコピーされる
+// イテレータと要素への参照は、再ハッシュ(insert時の拡張、reserve, rehash)で無効になる
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, T>>>
+class flat_hash_map
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+
+    static constexpr size_type group_size = 16;
+
+private:
+    using ctrl_t = std::int8_t;
+    static constexpr ctrl_t empty_ctrl = -128;
+    static constexpr ctrl_t deleted_ctrl = -2;
+
+    using traits = std::allocator_traits<allocator_type>;
+    using ctrl_allocator = typename traits::template rebind_alloc<ctrl_t>;
+    using ctrl_traits = std::allocator_traits<ctrl_allocator>;
+
+    // 16個の制御バイトのうち、条件に合うものをビットマスクで返す
+    struct group
+    {
+#if defined(__SSE2__)
+        __m128i ctrl;
+        explicit group(const ctrl_t *p) noexcept : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) {}
+        unsigned match(ctrl_t h2) const noexcept
+        {
+            return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+        }
+        unsigned match_empty() const noexcept
+        {
+            return match(empty_ctrl);
+        }
+        // emptyもdeletedも負で、-1より小さい
+        unsigned match_empty_or_deleted() const noexcept
+        {
+            return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)));
+        }
+#else
+        const ctrl_t *ctrl;
+        explicit group(const ctrl_t *p) noexcept : ctrl(p) {}
+        template <typename F>
+        unsigned mask_if(F f) const noexcept
+        {
+            unsigned m = 0;
+            for (unsigned i = 0; i != group_size; ++i)
+            {
+                m |= static_cast<unsigned>(f(ctrl[i])) << i;
+            }
+            return m;
+        }
+        unsigned match(ctrl_t h2) const noexcept
+        {
+            return mask_if([h2](ctrl_t c)
+                           { return c == h2; });
+        }
+        unsigned match_empty() const noexcept
+        {
+            return match(empty_ctrl);
+        }
+        unsigned match_empty_or_deleted() const noexcept
+        {
+            return mask_if([](ctrl_t c)
+                           { return c < -1; });
+        }
+#endif
+    };
+
+public:
+    template <bool Const>
+    class basic_iterator
+    {
+        using owner = std::conditional_t<Const, const flat_hash_map, flat_hash_map>;
+        owner *m = nullptr;
+        size_type i = 0;
+
+        friend class flat_hash_map;
+        friend class basic_iterator<!Const>;
+
+        basic_iterator(owner *m, size_type i) noexcept : m(m), i(i)
+        {
+            skip_free();
+        }
+        void skip_free() noexcept
+        {
+            while (i != m->slot_count && m->ctrl[i] < 0)
+            {
+                ++i;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = flat_hash_map::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type &, value_type &>;
+        using pointer = std::conditional_t<Const, const value_type *, value_type *>;
+
+        basic_iterator() = default;
+        // iteratorからconst_iteratorへの変換
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        basic_iterator(const basic_iterator<false> &r) noexcept : m(r.m), i(r.i)
+        {
+        }
+
+        reference operator*() const noexcept { return m->slots[i]; }
+        pointer operator->() const noexcept { return m->slots + i; }
+        basic_iterator &operator++() noexcept
+        {
+            ++i;
+            skip_free();
+            return *this;
+        }
+        basic_iterator operator++(int) noexcept
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+        friend bool operator==(const basic_iterator &l, const basic_iterator &r) noexcept { return l.i == r.i; }
+    };
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    explicit flat_hash_map(const allocator_type &alloc) noexcept : alloc(alloc) {}
+    flat_hash_map() : flat_hash_map(allocator_type()) {}
+    explicit flat_hash_map(size_type n, const hasher &hash = hasher(), const key_equal &eq = key_equal(),
+                           const allocator_type &alloc = allocator_type())
+        : hash(hash), eq(eq), alloc(alloc)
+    {
+        reserve(n);
+    }
+    flat_hash_map(std::initializer_list<value_type> init, const allocator_type &alloc = allocator_type()) : flat_hash_map(alloc)
+    {
+        reserve(init.size());
+        for (auto &v : init)
+        {
+            insert(v);
+        }
+    }
+    ~flat_hash_map()
+    {
+        clear();
+        deallocate(ctrl, slots, slot_count);
+    }
+
+    flat_hash_map(const flat_hash_map &r)
+        : hash(r.hash), eq(r.eq), alloc(traits::select_on_container_copy_construction(r.alloc))
+    {
+        reserve(r.size());
+        for (auto &v : r)
+        {
+            insert_unique(hash_of(v.first), v);
+        }
+    }
+    flat_hash_map(flat_hash_map &&r) noexcept
+        : ctrl(r.ctrl), slots(r.slots), slot_count(r.slot_count), elements(r.elements), growth_left(r.growth_left),
+          hash(std::move(r.hash)), eq(std::move(r.eq)), alloc(std::move(r.alloc))
+    {
+        r.release();
+    }
+    flat_hash_map &operator=(const flat_hash_map &r)
+    {
+        if (this != &r)
+        {
+            flat_hash_map copy(r);
+            swap(copy);
+        }
+        return *this;
+    }
+    flat_hash_map &operator=(flat_hash_map &&r) noexcept
+    {
+        if (this != &r)
+        {
+            clear();
+            deallocate(ctrl, slots, slot_count);
+            ctrl = r.ctrl;
+            slots = r.slots;
+            slot_count = r.slot_count;
+            elements = r.elements;
+            growth_left = r.growth_left;
+            hash = std::move(r.hash);
+            eq = std::move(r.eq);
+            alloc = std::move(r.alloc);
+            r.release();
+        }
+        return *this;
+    }
+    void swap(flat_hash_map &r) noexcept
+    {
+        using std::swap;
+        swap(ctrl, r.ctrl);
+        swap(slots, r.slots);
+        swap(slot_count, r.slot_count);
+        swap(elements, r.elements);
+        swap(growth_left, r.growth_left);
+        swap(hash, r.hash);
+        swap(eq, r.eq);
+        swap(alloc, r.alloc);
+    }
+
+    iterator begin() noexcept { return {this, 0}; }
+    iterator end() noexcept { return {this, slot_count}; }
+    const_iterator begin() const noexcept { return {this, 0}; }
+    const_iterator end() const noexcept { return {this, slot_count}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    size_type size() const noexcept { return elements; }
+    bool empty() const noexcept { return elements == 0; }
+    // スロットの数。要素はこの7/8まで入る
+    size_type capacity() const noexcept { return slot_count; }
+    float load_factor() const noexcept
+    {
+        return slot_count == 0 ? 0.0f : static_cast<float>(elements) / static_cast<float>(slot_count);
+    }
+    static constexpr float max_load_factor() noexcept { return 7.0f / 8.0f; }
+    allocator_type get_allocator() const noexcept { return alloc; }
+    hasher hash_function() const { return hash; }
+    key_equal key_eq() const { return eq; }
+
+    void clear() noexcept
+    {
+        for (size_type i = 0; i != slot_count; ++i)
+        {
+            if (ctrl[i] >= 0)
+            {
+                traits::destroy(alloc, slots + i);
+            }
+        }
+        std::fill(ctrl, ctrl + slot_count, empty_ctrl);
+        elements = 0;
+        growth_left = max_size_for(slot_count);
+    }
+
+    // n個の要素を入れても再ハッシュが起きないようにする
+    void reserve(size_type n)
+    {
+        if (n > max_size_for(slot_count))
+        {
+            rehash(n);
+        }
+    }
+    // スロット数をn個の要素が入る最小の2のべき(16以上)にして、全要素を入れ直す
+    // 削除済みのスロットもここで片付く。rehash(0)は今の要素数に合わせて縮める
+    void rehash(size_type n)
+    {
+        n = std::max(n, elements);
+        size_type fresh = 0;
+        if (n != 0)
+        {
+            fresh = group_size;
+            while (max_size_for(fresh) < n)
+            {
+                fresh *= 2;
+            }
+        }
+        if (fresh == slot_count && elements + growth_left == max_size_for(slot_count))
+        {
+            return;
+        }
+        TRACE_SCOPE("flat_hash_map::rehash");
+        reallocate(fresh, [&]
+                   { resize(fresh); });
+    }
+
+    // Keyの代わりに使える型。Hashとkey_equalがどちらもis_transparentなら、Key以外でも検索できる
+    template <typename K>
+    static constexpr bool lookup_key = std::is_convertible_v<const K &, const Key &> ||
+                                       (requires { typename Hash::is_transparent; typename KeyEqual::is_transparent; });
+
+    template <typename K = Key>
+        requires lookup_key<K>
+    iterator find(const K &key)
+    {
+        return {this, find_index(key)};
+    }
+    template <typename K = Key>
+        requires lookup_key<K>
+    const_iterator find(const K &key) const
+    {
+        return {this, find_index(key)};
+    }
+    template <typename K = Key>
+        requires lookup_key<K>
+    bool contains(const K &key) const
+    {
+        return find_index(key) != slot_count;
+    }
+    template <typename K = Key>
+        requires lookup_key<K>
+    size_type count(const K &key) const
+    {
+        return contains(key) ? 1 : 0;
+    }
+    template <typename K = Key>
+        requires lookup_key<K>
+    T &at(const K &key)
+    {
+        auto i = find_index(key);
+        if (i == slot_count)
+        {
+            throw std::out_of_range("flat_hash_map: key is not found.");
+        }
+        return slots[i].second;
+    }
+    template <typename K = Key>
+        requires lookup_key<K>
+    const T &at(const K &key) const
+    {
+        auto i = find_index(key);
+        if (i == slot_count)
+        {
+            throw std::out_of_range("flat_hash_map: key is not found.");
+        }
+        return slots[i].second;
+    }
+    T &operator[](const Key &key)
+    {
+        return try_emplace(key).first->second;
+    }
+    T &operator[](Key &&key)
+    {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    // keyがなければ、argsからmapped_typeを構築して入れる。あれば何もしない
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace(K &&key, Args &&...args)
+    {
+        auto h = hash_of(key);
+        auto i = find_index(key, h);
+        if (i != slot_count)
+        {
+            return {{this, i}, false};
+        }
+        i = insert_unique(h, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+        return {{this, i}, true};
+    }
+    std::pair<iterator, bool> insert(const value_type &value)
+    {
+        return try_emplace(value.first, value.second);
+    }
+    // value.firstはconstなのでmoveできず、キーはコピーになる
+    std::pair<iterator, bool> insert(value_type &&value)
+    {
+        return try_emplace(value.first, std::move(value.second));
+    }
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key &key, M &&obj)
+    {
+        auto r = try_emplace(key, std::forward<M>(obj));
+        if (!r.second)
+        {
+            r.first->second = std::forward<M>(obj);
+        }
+        return r;
+    }
+    // 要素を1つ構築してからキーを調べる(すでにあれば構築した要素は捨てる)
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&...args)
+    {
+        value_type v(std::forward<Args>(args)...);
+        return insert(std::move(v));
+    }
+
+    template <typename K = Key>
+        requires lookup_key<K>
+    size_type erase(const K &key)
+    {
+        auto i = find_index(key);
+        if (i == slot_count)
+        {
+            return 0;
+        }
+        erase_at(i);
+        return 1;
+    }
+    // 次の要素を指すイテレータを返す
+    iterator erase(const_iterator pos)
+    {
+        erase_at(pos.i);
+        return {this, pos.i + 1};
+    }
+
+private:
+    ctrl_t *ctrl = nullptr;
+    pointer slots = nullptr;
+    size_type slot_count = 0;
+    size_type elements = 0;
+    // emptyのスロットをあと何個使えるか。deletedは再利用しても減らない
+    size_type growth_left = 0;
+    [[no_unique_address]] hasher hash;
+    [[no_unique_address]] key_equal eq;
+    [[no_unique_address]] allocator_type alloc;
+
+    static constexpr size_type max_size_for(size_type slots) noexcept
+    {
+        return slots - slots / 8;
+    }
+
+    // std::hash<int>のように値をそのまま返すハッシュでも上位・下位のビットが散らばるよう混ぜる
+    template <typename K>
+    std::size_t hash_of(const K &key) const
+    {
+        std::uint64_t h = static_cast<std::uint64_t>(hash(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+    static ctrl_t h2(std::size_t h) noexcept
+    {
+        return static_cast<ctrl_t>(h & 0x7f);
+    }
+
+    // h1で選んだグループから、1, 2, 3, ...グループずつ離れたグループを順に見る(三角数の探索)
+    // グループ数は2のべきなので、全てのグループを1度ずつ訪れる
+    class probe
+    {
+        size_type mask, offset, stride = 0;
+
+    public:
+        probe(std::size_t h, size_type slot_count) noexcept
+            : mask(slot_count / group_size - 1), offset((h >> 7) & mask) {}
+        size_type slot() const noexcept { return offset * group_size; }
+        void next() noexcept
+        {
+            ++stride;
+            offset = (offset + stride) & mask;
+        }
+    };
+
+    template <typename K>
+    size_type find_index(const K &key) const
+    {
+        return find_index(key, hash_of(key));
+    }
+    template <typename K>
+    size_type find_index(const K &key, std::size_t h) const
+    {
+        if (slot_count == 0)
+        {
+            return 0;
+        }
+        for (probe p(h, slot_count);; p.next())
+        {
+            group g(ctrl + p.slot());
+            for (auto m = g.match(h2(h)); m != 0; m &= m - 1)
+            {
+                auto i = p.slot() + static_cast<size_type>(std::countr_zero(m));
+                if (eq(slots[i].first, key)) [[likely]]
+                {
+                    return i;
+                }
+            }
+            if (g.match_empty() != 0) [[likely]]
+            {
+                return slot_count;
+            }
+        }
+    }
+    // 探索の列で最初のemptyかdeletedのスロット
+    size_type find_free(std::size_t h) const noexcept
+    {
+        for (probe p(h, slot_count);; p.next())
+        {
+            auto m = group(ctrl + p.slot()).match_empty_or_deleted();
+            if (m != 0)
+            {
+                return p.slot() + static_cast<size_type>(std::countr_zero(m));
+            }
+        }
+    }
+
+    // キーがまだないと分かっている時に入れる
+    template <typename... Args>
+    size_type insert_unique(std::size_t h, Args &&...args)
+    {
+        if (slot_count == 0)
+        {
+            rehash(1);
+        }
+        auto i = find_free(h);
+        // emptyを使う時だけ空きが減る。空きがなければ広げる(deletedが多ければ同じ大きさで片付ける)
+        if (growth_left == 0 && ctrl[i] == empty_ctrl)
+        {
+            rehash(elements + 1 > max_size_for(slot_count) / 2 ? max_size_for(slot_count * 2) : elements + 1);
+            i = find_free(h);
+        }
+        traits::construct(alloc, slots + i, std::forward<Args>(args)...);
+        growth_left -= ctrl[i] == empty_ctrl;
+        ctrl[i] = h2(h);
+        ++elements;
+        return i;
+    }
+    void erase_at(size_type i)
+    {
+        traits::destroy(alloc, slots + i);
+        --elements;
+        // グループにemptyがあれば、このグループは作られてから一度も埋まっていない
+        // つまりここを通り過ぎて先に置かれたキーはないので、emptyに戻してよい
+        auto group_start = i - i % group_size;
+        if (group(ctrl + group_start).match_empty() != 0)
+        {
+            ctrl[i] = empty_ctrl;
+            ++growth_left;
+        }
+        else
+        {
+            ctrl[i] = deleted_ctrl;
+        }
+    }
+
+    void allocate(size_type n, ctrl_t *&new_ctrl, pointer &new_slots)
+    {
+        ctrl_allocator ca(alloc);
+        new_ctrl = ctrl_traits::allocate(ca, n);
+        try
+        {
+            new_slots = traits::allocate(alloc, n);
+        }
+        catch (...)
+        {
+            ctrl_traits::deallocate(ca, new_ctrl, n);
+            throw;
+        }
+        std::fill(new_ctrl, new_ctrl + n, empty_ctrl);
+    }
+    void deallocate(ctrl_t *old_ctrl, pointer old_slots, size_type n) noexcept
+    {
+        if (n == 0)
+        {
+            return;
+        }
+        ctrl_allocator ca(alloc);
+        ctrl_traits::deallocate(ca, old_ctrl, n);
+        traits::deallocate(alloc, old_slots, n);
+    }
+    void release() noexcept
+    {
+        ctrl = nullptr;
+        slots = nullptr;
+        slot_count = 0;
+        elements = 0;
+        growth_left = 0;
+    }
+
+    // 新しい配列を確保し、全要素をmoveして入れ直す
+    void resize(size_type n)
+    {
+        ctrl_t *new_ctrl = nullptr;
+        pointer new_slots = nullptr;
+        if (n != 0)
+        {
+            allocate(n, new_ctrl, new_slots);
+        }
+        auto old_ctrl = std::exchange(ctrl, new_ctrl);
+        auto old_slots = std::exchange(slots, new_slots);
+        auto old_count = std::exchange(slot_count, n);
+        growth_left = max_size_for(n) - elements;
+        for (size_type i = 0; i != old_count; ++i)
+        {
+            if (old_ctrl[i] >= 0)
+            {
+                auto h = hash_of(old_slots[i].first);
+                auto j = find_free(h);
+                traits::construct(alloc, slots + j, std::move(old_slots[i]));
+                ctrl[j] = h2(h);
+                traits::destroy(alloc, old_slots + i);
+            }
+        }
+        deallocate(old_ctrl, old_slots, old_count);
+    }
+
+    // vectorのreallocateと同じく、アロケータがon_reallocateを持っていれば時間と前後の容量を通知する
+    template <typename F>
+    void reallocate(size_type new_capacity, F f)
+    {
+        if constexpr (requires(allocator_type &a) { a.on_reallocate(size_type(), size_type(), size_type(), std::chrono::nanoseconds()); })
+        {
+            auto old_capacity = capacity();
+            auto start = std::chrono::steady_clock::now();
+            f();
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            alloc.on_reallocate(size(), old_capacity, new_capacity, elapsed);
+        }
+        else
+        {
+            f();
+        }
+    }
+};
+
+#endif
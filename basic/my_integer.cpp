@@ -1,115 +1,51 @@
 #include <iostream>
-
-struct Integer
-{
-    int *ptr;
-
-    friend Integer operator+(const Integer &l, const Integer &r);
-    friend Integer operator+(Integer &&l, const Integer &r);
-    friend Integer operator+(const Integer &l, Integer &&r);
-    friend Integer operator+(Integer &&l, Integer &&r);
-
-public:
-    explicit Integer(int value = 0) : ptr(new int(value)) {}
-
-    ~Integer()
-    {
-        delete ptr;
-    }
-
-    Integer(const Integer &r) : ptr(new int(*r.ptr)){}
-    Integer &operator=(const Integer &r)
-    {
-        if (this != &r)
-        {
-            *ptr = *r.ptr;
-        }
-        return *this;
-    }
-    Integer(Integer &&r) : ptr(r.ptr)
-    {
-        r.ptr = nullptr;
-    }
-    // 本では返り値が Integer になっていたが誤り
-    // (a = Integer(10)) = Integer(15);
-    // の結果が10になってしまう。また、returnするときにコピーコンストラクタが呼ばれる
-    Integer &operator=(Integer &&r)
-    {
-        delete ptr;
-        ptr = r.ptr;
-        r.ptr = nullptr;
-        return *this;
-    }
-
-    Integer &operator+=(const Integer &r)
-    {
-        *ptr += *r.ptr;
-        return *this;
-    }
-    Integer &operator-=(const Integer &r)
-    {
-        *ptr -= *r.ptr;
-        return *this;
-    }
-
-    // lvalue
-    // rvalue版があるので明示的に&が必要
-    // 当然ながら返り値はInteger &ではだめ。スタックの参照を返すから
-    Integer operator-() const &
-    {
-        Integer result(-*ptr);
-        // compiler do
-        // return std::move(result)
-        return result;
-    }
-
-    // rvalue
-    // -(a+a) 等に効果的
-    // 意味的には以下と同じ
-    // Integer operator-(Integer && THIS) {
-    //   Integer * this = &THIS;
-    // }
-    Integer operator-() &&
-    {
-        // call move constructor here
-        auto result = std::move(*this);
-        *result.ptr = -*result.ptr;
-        return result;
-    }
-};
-
-Integer operator+(const Integer &l, const Integer &r)
-{
-    auto result = l;
-    result += r;
-    return result;
-}
-
-Integer operator+(Integer &&l, const Integer &r)
-{
-    auto result = std::move(l);
-    result += r;
-    return result;
-}
-Integer operator+(const Integer &l, Integer &&r)
-{
-
-    auto result = std::move(r);
-    result += l;
-    return result;
-}
-Integer operator+(Integer &&l, Integer &&r)
-{
-    // operator+(Integer&& l, const Integer& r) を呼んでいるだけ
-    return std::move(l) + r;
-}
+#include "my_integer.hpp"
 
 int main()
 {
     Integer a(100);
-    auto b = -(a + a);
-    auto c = a + a + a;
+    // 式テンプレートなので、Integerで受けた時点で1パスで評価される
+    Integer b = -(a + a);
+    Integer c = a + a + a;
     (a = Integer(10)) = Integer(15);
     // 15
-    std::cout << *a.ptr << std::endl;
-}
\ No newline at end of file
+    std::cout << a << std::endl;
+    // -200 300 true
+    std::cout << b << ' ' << c << ' ' << std::boolalpha << c.is_inline() << std::endl;
+    // 2^32以上でも64bitに収まる和はインラインのまま。溢れた時だけヒープに移る
+    Integer w(1LL << 40);
+    w += Integer(1LL << 41);
+    Integer big(0x7fffffffffffffffLL);
+    big += big;
+    auto word = big.is_inline();
+    big += big;
+    // 3298534883328 true true 36893488147419103228 false
+    std::cout << w << ' ' << w.is_inline() << ' ' << word << ' ' << big << ' ' << big.is_inline() << std::endl;
+
+    // 30! = 265252859812191058636308480000000
+    Integer f(1);
+    for (int i = 2; i <= 30; ++i)
+    {
+        f *= Integer(i);
+    }
+    std::cout << f << std::endl;
+    std::cout << (f / Integer("265252859812191058636308480000") == Integer(1000)) << std::endl;
+    // C++の組み込み整数と同じ規則: -7 / 2 = -3, -7 % 2 = -1
+    std::cout << Integer(-7) / Integer(2) << ' ' << Integer(-7) % Integer(2) << std::endl;
+
+    // Karatsuba法が使われる大きさで検算する: (x * y) / y == x, (x * y + 5) % y == 5
+    Integer x("1"), y("1");
+    for (int i = 0; i != 400; ++i)
+    {
+        x = x * Integer(1000000007) + Integer(i);
+        y = y * Integer(998244353) - Integer(i);
+    }
+    auto xy = x * y;
+    std::cout << (xy / y == x) << ' ' << ((xy + Integer(5)) % y == Integer(5)) << ' ' << Integer(xy - x * y).is_zero() << std::endl;
+
+    // 長い足し引きも一時オブジェクトを作らずに、代入先に直接1パスで書き込む
+    Integer total;
+    total = x + y - xy + x - y + xy;
+    total -= x + x;
+    std::cout << total.is_zero() << std::endl;
+}
@@ -0,0 +1,1053 @@
+#ifndef MY_INTEGER_HPP
+#define MY_INTEGER_HPP
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <concepts>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <utility>
+
+// 多倍長整数
+// 以前はnew intで1つのintをヒープに持っていたので、a + a + aの一時オブジェクトごとにmallocが走り、しかも32bitで溢れていた
+// * 符号と絶対値(32bitのlimbの配列、下位が先頭)で表す
+// * 64bit(limb 2つ)に収まる値はオブジェクト内(small)に置き、ヒープを使わない
+// * 足し算・引き算は繰り上がり(繰り下がり)を伝播させるだけ
+// * 掛け算は小さいうちは筆算、大きくなったらKaratsuba法
+// * 割り算はKnuthのAlgorithm D。C++の組み込み整数と同じく商は0方向に切り捨て、余りの符号は被除数と同じ
+// * +と-は式テンプレート(後述)で、代入するときにまとめて1パスで計算する
+class Integer;
+
+// 式テンプレートを平らにした時の1項。minusなら引く
+struct integer_term
+{
+    const Integer *value;
+    bool minus;
+};
+
+// a + b - c のような、まだ評価していない式の型
+template <typename E>
+concept integer_expression = std::remove_cvref_t<E>::is_integer_expression;
+
+class Integer
+{
+    using limb = std::uint32_t;
+    using wide = std::uint64_t;
+    static constexpr std::uint32_t limb_bits = 32;
+    static constexpr std::uint32_t inline_capacity = 2;
+    // これより短い方のlimb数が小さければ筆算の方が速い
+    static constexpr std::size_t karatsuba_threshold = 32;
+
+    std::uint32_t used = 0; // 絶対値のlimb数。0なら値は0
+    std::uint32_t cap = inline_capacity;
+    bool negative = false;
+    union
+    {
+        limb small[inline_capacity];
+        limb *heap;
+    };
+
+public:
+    // 64bitに収まるのでヒープは使わない
+    explicit Integer(long long value = 0) : small{0, 0}
+    {
+        negative = value < 0;
+        // -LLONG_MINはオーバーフローするのでunsignedで符号反転する
+        wide magnitude = negative ? 0 - static_cast<wide>(value) : static_cast<wide>(value);
+        small[0] = static_cast<limb>(magnitude);
+        small[1] = static_cast<limb>(magnitude >> limb_bits);
+        used = 2;
+        trim();
+    }
+    // 10進数の文字列から作る。先頭に'-'または'+'を許す
+    explicit Integer(std::string_view text) : Integer()
+    {
+        bool minus = false;
+        if (!text.empty() && (text[0] == '-' || text[0] == '+'))
+        {
+            minus = text[0] == '-';
+            text.remove_prefix(1);
+        }
+        if (text.empty())
+        {
+            throw std::invalid_argument("Integer: empty string.");
+        }
+        // 9桁ずつまとめて *10^9 + chunk する
+        while (!text.empty())
+        {
+            auto n = std::min<std::size_t>(text.size(), 9);
+            limb chunk = 0, scale = 1;
+            for (std::size_t i = 0; i != n; ++i)
+            {
+                if (text[i] < '0' || text[i] > '9')
+                {
+                    throw std::invalid_argument("Integer: not a decimal number.");
+                }
+                chunk = chunk * 10 + static_cast<limb>(text[i] - '0');
+                scale *= 10;
+            }
+            mul_add_small(scale, chunk);
+            text.remove_prefix(n);
+        }
+        negative = minus && used != 0;
+    }
+
+    ~Integer()
+    {
+        if (is_heap())
+        {
+            delete[] heap;
+        }
+    }
+
+    // コピー先の容量はコピー元の容量ではなく、値の大きさで決める
+    Integer(const Integer &r) : small{0, 0}
+    {
+        reserve(r.used);
+        std::copy_n(r.digits(), r.used, digits());
+        used = r.used;
+        negative = r.negative;
+    }
+    Integer &operator=(const Integer &r)
+    {
+        if (this != &r)
+        {
+            reserve(r.used);
+            std::copy_n(r.digits(), r.used, digits());
+            used = r.used;
+            negative = r.negative;
+        }
+        return *this;
+    }
+    // ヒープにある場合はポインタを付け替えるだけ。moveされた側は0になる
+    Integer(Integer &&r) noexcept : used(r.used), cap(r.cap), negative(r.negative)
+    {
+        if (r.is_heap())
+        {
+            heap = r.heap;
+        }
+        else
+        {
+            small[0] = r.small[0];
+            small[1] = r.small[1];
+        }
+        r.reset();
+    }
+    // 本では返り値が Integer になっていたが誤り
+    // (a = Integer(10)) = Integer(15);
+    // の結果が10になってしまう。また、returnするときにコピーコンストラクタが呼ばれる
+    Integer &operator=(Integer &&r) noexcept
+    {
+        if (this != &r)
+        {
+            if (is_heap())
+            {
+                delete[] heap;
+            }
+            used = r.used;
+            cap = r.cap;
+            negative = r.negative;
+            if (r.is_heap())
+            {
+                heap = r.heap;
+            }
+            else
+            {
+                small[0] = r.small[0];
+                small[1] = r.small[1];
+            }
+            r.reset();
+        }
+        return *this;
+    }
+
+    // 式テンプレートから作る
+    // 式がrvalueのIntegerを持っていれば(a + b + cのa + bの結果等)、その領域を結果にそのまま使う
+    template <integer_expression E>
+    Integer(E &&e) : Integer()
+    {
+        using expr = std::remove_cvref_t<E>;
+        std::array<integer_term, expr::terms> t;
+        e.collect(t.data(), false);
+        if constexpr (!std::is_lvalue_reference_v<E>)
+        {
+            if (Integer *owned = e.owned())
+            {
+                *this = std::move(*owned);
+                for (auto &x : t)
+                {
+                    if (x.value == owned)
+                    {
+                        x.value = this;
+                    }
+                }
+            }
+        }
+        evaluate(t);
+    }
+    // 代入先の領域に直接書き込む。a = a + b のように代入先が式に含まれていてもよい
+    template <integer_expression E>
+    Integer &operator=(E &&e)
+    {
+        std::array<integer_term, std::remove_cvref_t<E>::terms> t;
+        e.collect(t.data(), false);
+        evaluate(t);
+        return *this;
+    }
+    template <integer_expression E>
+    Integer &operator+=(E &&e)
+    {
+        std::array<integer_term, std::remove_cvref_t<E>::terms + 1> t;
+        t[0] = {this, false};
+        e.collect(t.data() + 1, false);
+        evaluate(t);
+        return *this;
+    }
+    template <integer_expression E>
+    Integer &operator-=(E &&e)
+    {
+        std::array<integer_term, std::remove_cvref_t<E>::terms + 1> t;
+        t[0] = {this, false};
+        e.collect(t.data() + 1, true);
+        evaluate(t);
+        return *this;
+    }
+
+    Integer &operator+=(const Integer &r)
+    {
+        if (negative == r.negative)
+        {
+            add_magnitude(r);
+        }
+        else
+        {
+            sub_magnitude(r);
+        }
+        return *this;
+    }
+    Integer &operator-=(const Integer &r)
+    {
+        if (this == &r)
+        {
+            return *this = Integer();
+        }
+        if (negative != r.negative)
+        {
+            add_magnitude(r);
+        }
+        else
+        {
+            sub_magnitude(r);
+        }
+        return *this;
+    }
+    Integer &operator*=(const Integer &r)
+    {
+        // 結果のlimb数は高々used + r.used。両方1limb以下なら結果もインラインに収まる
+        Integer result;
+        result.reserve(used + r.used);
+        std::fill_n(result.digits(), used + r.used, 0);
+        multiply(result.digits(), digits(), used, r.digits(), r.used);
+        result.used = used + r.used;
+        result.negative = negative != r.negative;
+        result.trim();
+        return *this = std::move(result);
+    }
+    Integer &operator/=(const Integer &r)
+    {
+        Integer quotient, remainder;
+        divide(*this, r, &quotient, &remainder);
+        return *this = std::move(quotient);
+    }
+    Integer &operator%=(const Integer &r)
+    {
+        Integer quotient, remainder;
+        divide(*this, r, &quotient, &remainder);
+        return *this = std::move(remainder);
+    }
+
+    // lvalue
+    // rvalue版があるので明示的に&が必要
+    // 当然ながら返り値はInteger &ではだめ。スタックの参照を返すから
+    Integer operator-() const &
+    {
+        Integer result(*this);
+        result.negate();
+        // compiler do
+        // return std::move(result)
+        return result;
+    }
+
+    // rvalue
+    // -(a+a) 等に効果的
+    // 意味的には以下と同じ
+    // Integer operator-(Integer && THIS) {
+    //   Integer * this = &THIS;
+    // }
+    Integer operator-() &&
+    {
+        // call move constructor here
+        auto result = std::move(*this);
+        result.negate();
+        return result;
+    }
+
+    friend bool operator==(const Integer &l, const Integer &r) noexcept
+    {
+        return l.negative == r.negative && compare_magnitude(l, r) == 0;
+    }
+    friend std::strong_ordering operator<=>(const Integer &l, const Integer &r) noexcept
+    {
+        if (l.negative != r.negative)
+        {
+            return l.negative ? std::strong_ordering::less : std::strong_ordering::greater;
+        }
+        auto c = compare_magnitude(l, r);
+        if (l.negative)
+        {
+            c = -c;
+        }
+        return c <=> 0;
+    }
+
+    bool is_zero() const noexcept
+    {
+        return used == 0;
+    }
+    bool is_negative() const noexcept
+    {
+        return negative;
+    }
+    // ヒープを使っていないか(64bitに収まる値として作られたか)
+    bool is_inline() const noexcept
+    {
+        return !is_heap();
+    }
+
+    std::string to_string() const
+    {
+        if (used == 0)
+        {
+            return "0";
+        }
+        // 10^9で割った余りを下の桁から集める
+        Integer t(*this);
+        std::vector<limb> chunks;
+        while (t.used != 0)
+        {
+            chunks.push_back(t.div_small(1000000000));
+        }
+        std::string s = negative ? "-" : "";
+        s += std::to_string(chunks.back());
+        for (auto it = chunks.rbegin() + 1; it != chunks.rend(); ++it)
+        {
+            auto part = std::to_string(*it);
+            s.append(9 - part.size(), '0');
+            s += part;
+        }
+        return s;
+    }
+    friend std::ostream &operator<<(std::ostream &os, const Integer &v)
+    {
+        return os << v.to_string();
+    }
+
+private:
+    bool is_heap() const noexcept
+    {
+        return cap > inline_capacity;
+    }
+    limb *digits() noexcept
+    {
+        return is_heap() ? heap : small;
+    }
+    const limb *digits() const noexcept
+    {
+        return is_heap() ? heap : small;
+    }
+    // moveで領域を渡した後に呼ぶ。ヒープは解放しない
+    void reset() noexcept
+    {
+        used = 0;
+        cap = inline_capacity;
+        negative = false;
+        small[0] = 0;
+        small[1] = 0;
+    }
+    // 中身を保ったまま、少なくともnlimb入るようにする
+    void reserve(std::size_t n)
+    {
+        if (n <= cap)
+        {
+            return;
+        }
+        auto new_cap = std::max<std::size_t>(n, cap * 2);
+        limb *p = new limb[new_cap];
+        std::copy_n(digits(), used, p);
+        if (is_heap())
+        {
+            delete[] heap;
+        }
+        heap = p;
+        cap = static_cast<std::uint32_t>(new_cap);
+    }
+    // 上位の0のlimbを取り除く
+    void trim() noexcept
+    {
+        auto d = digits();
+        while (used != 0 && d[used - 1] == 0)
+        {
+            --used;
+        }
+        if (used == 0)
+        {
+            negative = false;
+        }
+    }
+    void negate() noexcept
+    {
+        if (used != 0)
+        {
+            negative = !negative;
+        }
+    }
+
+    static int compare_magnitude(const limb *a, std::size_t an, const limb *b, std::size_t bn) noexcept
+    {
+        if (an != bn)
+        {
+            return an < bn ? -1 : 1;
+        }
+        for (auto i = an; i-- != 0;)
+        {
+            if (a[i] != b[i])
+            {
+                return a[i] < b[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+    static int compare_magnitude(const Integer &l, const Integer &r) noexcept
+    {
+        return compare_magnitude(l.digits(), l.used, r.digits(), r.used);
+    }
+
+    // r = a + b (an >= bn)。rはan + 1limb分必要。rはaと同じ領域でもよい
+    static std::size_t add(limb *r, const limb *a, std::size_t an, const limb *b, std::size_t bn) noexcept
+    {
+        r[an] = add_carry(r, a, an, b, bn);
+        return an + 1;
+    }
+    // r = a + b (an >= bn) の下位an limbを書き、最上位への繰り上がりを返す。rはan limbあればよい
+    static limb add_carry(limb *r, const limb *a, std::size_t an, const limb *b, std::size_t bn) noexcept
+    {
+        wide carry = 0;
+        std::size_t i = 0;
+        for (; i != bn; ++i)
+        {
+            carry += static_cast<wide>(a[i]) + b[i];
+            r[i] = static_cast<limb>(carry);
+            carry >>= limb_bits;
+        }
+        for (; i != an; ++i)
+        {
+            carry += a[i];
+            r[i] = static_cast<limb>(carry);
+            carry >>= limb_bits;
+        }
+        return static_cast<limb>(carry);
+    }
+    // r = a - b (|a| >= |b|)。rはaまたはbと同じ領域でもよい
+    static void sub(limb *r, const limb *a, std::size_t an, const limb *b, std::size_t bn) noexcept
+    {
+        wide borrow = 0;
+        std::size_t i = 0;
+        for (; i != bn; ++i)
+        {
+            wide d = static_cast<wide>(a[i]) - b[i] - borrow;
+            r[i] = static_cast<limb>(d);
+            borrow = (d >> limb_bits) & 1;
+        }
+        for (; i != an; ++i)
+        {
+            wide d = static_cast<wide>(a[i]) - borrow;
+            r[i] = static_cast<limb>(d);
+            borrow = (d >> limb_bits) & 1;
+        }
+    }
+
+    // *this = Σ ±terms[k] を1パスで計算する
+    // 各limbの位置iで全ての項のi番目を符号付きで足し合わせ、繰り上がり(負もありうる)を次の位置に送る
+    // 位置iでは全ての項を読んでから書き込むので、*thisが項に含まれていても壊れない
+    // * 項を長い順に並べ、全ての項がそろっている範囲はcolumnでN項を展開して足し、
+    //   残りは短い項から外していく。内側のループに長さの比較を入れない
+    // * 符号はmask(0か-1)で(x ^ mask) - maskとして足し、項ごとの分岐をなくす
+    // * 繰り上がりのlimbは必要な時だけ確保する(64bitに収まる結果はインラインのまま)
+    // 位置iの全ての項の和。項数Nで展開させるため、ループではなく畳み込み式で書く
+    template <std::size_t N, std::size_t... K>
+    static std::int64_t column(std::index_sequence<K...>, const std::array<const limb *, N> &d,
+                               const std::array<std::int64_t, N> &mask, std::size_t i) noexcept
+    {
+        return (((static_cast<std::int64_t>(d[K][i]) ^ mask[K]) - mask[K]) + ...);
+    }
+
+    template <std::size_t N>
+    void evaluate(const std::array<integer_term, N> &terms)
+    {
+        std::size_t len = 0;
+        for (auto &t : terms)
+        {
+            len = std::max<std::size_t>(len, t.value->used);
+        }
+        reserve(len);
+        // reserveで自分の領域が移動しうるので、各項のポインタはその後に取る
+        struct operand
+        {
+            const limb *d;
+            std::size_t n;
+            std::int64_t mask;
+        };
+        std::array<operand, N> ops;
+        for (std::size_t k = 0; k != N; ++k)
+        {
+            auto v = terms[k].value;
+            ops[k] = {v->digits(), v->used, terms[k].minus != v->negative ? -1 : 0};
+        }
+        // Nは高々数個なので挿入ソートで長い順にする
+        for (std::size_t k = 1; k < N; ++k)
+        {
+            for (auto j = k; j != 0 && ops[j - 1].n < ops[j].n; --j)
+            {
+                std::swap(ops[j - 1], ops[j]);
+            }
+        }
+        std::array<const limb *, N> d;
+        std::array<std::int64_t, N> mask;
+        for (std::size_t k = 0; k != N; ++k)
+        {
+            d[k] = ops[k].d;
+            mask[k] = ops[k].mask;
+        }
+        auto r = digits();
+        std::int64_t carry = 0;
+        std::size_t i = 0;
+        for (; i < ops[N - 1].n; ++i)
+        {
+            std::int64_t acc = carry + column(std::make_index_sequence<N>{}, d, mask, i);
+            r[i] = static_cast<limb>(acc);
+            // 算術右シフト(C++20で規定された)なので負の繰り上がりも正しく伝わる
+            carry = acc >> limb_bits;
+        }
+        for (std::size_t active = N; i != len; ++i)
+        {
+            while (ops[active - 1].n <= i)
+            {
+                --active;
+            }
+            std::int64_t acc = carry;
+            for (std::size_t k = 0; k != active; ++k)
+            {
+                acc += (static_cast<std::int64_t>(ops[k].d[i]) ^ ops[k].mask) - ops[k].mask;
+            }
+            r[i] = static_cast<limb>(acc);
+            carry = acc >> limb_bits;
+        }
+        used = static_cast<std::uint32_t>(len);
+        negative = false;
+        if (carry == 0)
+        {
+            trim();
+            return;
+        }
+        // 値は r + carry * B^len。carryが-1で下位が0でなければ、絶対値 B^len - r はlen limbに収まる
+        std::size_t width = len;
+        if (carry != -1 || significant(r, len) == 0)
+        {
+            reserve(len + 1);
+            r = digits();
+            r[len] = static_cast<limb>(carry);
+            used = static_cast<std::uint32_t>(++width);
+        }
+        if (carry < 0)
+        {
+            // 2の補数表現になっているので、反転して1を足して絶対値に戻す
+            wide c = 1;
+            for (std::size_t j = 0; j != width; ++j)
+            {
+                c += static_cast<limb>(~r[j]);
+                r[j] = static_cast<limb>(c);
+                c >>= limb_bits;
+            }
+            negative = true;
+        }
+        trim();
+    }
+
+    // |this| += |r|
+    // 繰り上がりのlimbは実際に繰り上がった時だけ確保する。64bitどうしの和が64bitに収まればインラインのまま
+    void add_magnitude(const Integer &r)
+    {
+        auto n = std::max(used, r.used);
+        // this == &rならn == usedなので、reserveでrの領域が移動することはない
+        reserve(n);
+        // reserveで自分の領域が移動しうるので、ポインタはその後に取る
+        auto carry = used >= r.used ? add_carry(digits(), digits(), used, r.digits(), r.used)
+                                    : add_carry(digits(), r.digits(), r.used, digits(), used);
+        used = n;
+        if (carry != 0)
+        {
+            reserve(n + 1);
+            digits()[n] = carry;
+            ++used;
+        }
+    }
+    // |this| -= |r|。|r|の方が大きければ符号が反転する
+    void sub_magnitude(const Integer &r)
+    {
+        auto c = compare_magnitude(*this, r);
+        if (c == 0)
+        {
+            // 領域は確保したまま値だけ0にする
+            used = 0;
+            negative = false;
+            return;
+        }
+        if (c > 0)
+        {
+            sub(digits(), digits(), used, r.digits(), r.used);
+        }
+        else
+        {
+            reserve(r.used);
+            sub(digits(), r.digits(), r.used, digits(), used);
+            used = r.used;
+            negative = !negative;
+        }
+        trim();
+    }
+
+    // 筆算。rはan + bn limb分0で初期化されていること
+    static void multiply_school(limb *r, const limb *a, std::size_t an, const limb *b, std::size_t bn) noexcept
+    {
+        for (std::size_t i = 0; i != an; ++i)
+        {
+            wide carry = 0;
+            for (std::size_t j = 0; j != bn; ++j)
+            {
+                carry += static_cast<wide>(a[i]) * b[j] + r[i + j];
+                r[i + j] = static_cast<limb>(carry);
+                carry >>= limb_bits;
+            }
+            r[i + bn] = static_cast<limb>(carry);
+        }
+    }
+
+    // r += a (rの残りの桁へ繰り上がりを伝播する)
+    static void add_into(limb *r, std::size_t rn, const limb *a, std::size_t an) noexcept
+    {
+        wide carry = 0;
+        std::size_t i = 0;
+        for (; i != an; ++i)
+        {
+            carry += static_cast<wide>(r[i]) + a[i];
+            r[i] = static_cast<limb>(carry);
+            carry >>= limb_bits;
+        }
+        for (; carry != 0 && i != rn; ++i)
+        {
+            carry += r[i];
+            r[i] = static_cast<limb>(carry);
+            carry >>= limb_bits;
+        }
+    }
+
+    static std::size_t significant(const limb *a, std::size_t n) noexcept
+    {
+        while (n != 0 && a[n - 1] == 0)
+        {
+            --n;
+        }
+        return n;
+    }
+
+    // r = a * b。rはan + bn limb分0で初期化されていること
+    // Karatsuba法: a = a1 * B^m + a0, b = b1 * B^m + b0 とすると
+    //   a * b = z2 * B^2m + (z1 - z2 - z0) * B^m + z0
+    //   z0 = a0 * b0, z2 = a1 * b1, z1 = (a0 + a1) * (b0 + b1)
+    // で、4回の掛け算が3回になる
+    static void multiply(limb *r, const limb *a, std::size_t an, const limb *b, std::size_t bn)
+    {
+        if (an < bn)
+        {
+            std::swap(a, b);
+            std::swap(an, bn);
+        }
+        if (bn < karatsuba_threshold)
+        {
+            multiply_school(r, a, an, b, bn);
+            return;
+        }
+        std::size_t m = an / 2;
+        if (bn <= m)
+        {
+            // bが短い場合は、aを半分に分けてそれぞれbと掛ける
+            std::vector<limb> t(an - m + bn, 0);
+            multiply(r, a, m, b, bn);
+            multiply(t.data(), a + m, an - m, b, bn);
+            add_into(r + m, an + bn - m, t.data(), significant(t.data(), t.size()));
+            return;
+        }
+        const limb *a0 = a, *a1 = a + m, *b0 = b, *b1 = b + m;
+        std::size_t a0n = significant(a0, m), b0n = significant(b0, m);
+        std::size_t a1n = an - m, b1n = bn - m;
+
+        std::vector<limb> z0(a0n + b0n, 0), z2(a1n + b1n, 0);
+        multiply(z0.data(), a0, a0n, b0, b0n);
+        multiply(z2.data(), a1, a1n, b1, b1n);
+
+        std::vector<limb> sa(std::max(a0n, a1n) + 1), sb(std::max(b0n, b1n) + 1);
+        std::size_t san = a0n >= a1n ? add(sa.data(), a0, a0n, a1, a1n) : add(sa.data(), a1, a1n, a0, a0n);
+        std::size_t sbn = b0n >= b1n ? add(sb.data(), b0, b0n, b1, b1n) : add(sb.data(), b1, b1n, b0, b0n);
+        san = significant(sa.data(), san);
+        sbn = significant(sb.data(), sbn);
+
+        std::vector<limb> z1(san + sbn, 0);
+        multiply(z1.data(), sa.data(), san, sb.data(), sbn);
+        auto z1n = significant(z1.data(), z1.size());
+        auto z0n = significant(z0.data(), z0.size());
+        auto z2n = significant(z2.data(), z2.size());
+        // z1 - z0 - z2 は必ず0以上
+        sub(z1.data(), z1.data(), z1n, z0.data(), z0n);
+        z1n = significant(z1.data(), z1n);
+        sub(z1.data(), z1.data(), z1n, z2.data(), z2n);
+        z1n = significant(z1.data(), z1n);
+
+        auto rn = an + bn;
+        add_into(r, rn, z0.data(), z0n);
+        add_into(r + m, rn - m, z1.data(), z1n);
+        add_into(r + 2 * m, rn - 2 * m, z2.data(), z2n);
+    }
+
+    // *this = *this * scale + addend (1limbの値)
+    void mul_add_small(limb scale, limb addend)
+    {
+        reserve(used + 1);
+        auto d = digits();
+        wide carry = addend;
+        for (std::uint32_t i = 0; i != used; ++i)
+        {
+            carry += static_cast<wide>(d[i]) * scale;
+            d[i] = static_cast<limb>(carry);
+            carry >>= limb_bits;
+        }
+        d[used] = static_cast<limb>(carry);
+        ++used;
+        trim();
+    }
+    // |this| /= divisor (1limb) して余りを返す
+    limb div_small(limb divisor) noexcept
+    {
+        auto d = digits();
+        wide rem = 0;
+        for (auto i = used; i-- != 0;)
+        {
+            wide cur = (rem << limb_bits) | d[i];
+            d[i] = static_cast<limb>(cur / divisor);
+            rem = cur % divisor;
+        }
+        trim();
+        return static_cast<limb>(rem);
+    }
+
+    static int leading_zeros(limb x) noexcept
+    {
+        int n = 0;
+        while ((x & 0x80000000u) == 0)
+        {
+            x <<= 1;
+            ++n;
+        }
+        return n;
+    }
+
+    // KnuthのAlgorithm D (TAOCP 4.3.1)
+    // 除数の最上位limbの最上位bitが立つように両方を左シフトしておくと、商の1limbの推定値は真の値より高々2大きいだけになる
+    static void divide(const Integer &dividend, const Integer &divisor, Integer *quotient, Integer *remainder)
+    {
+        if (divisor.used == 0)
+        {
+            throw std::domain_error("Integer: division by zero.");
+        }
+        bool q_negative = dividend.negative != divisor.negative;
+        bool r_negative = dividend.negative;
+        if (compare_magnitude(dividend, divisor) < 0)
+        {
+            *remainder = dividend;
+            *quotient = Integer();
+            return;
+        }
+        if (divisor.used == 1)
+        {
+            Integer q(dividend);
+            auto rem = q.div_small(divisor.digits()[0]);
+            q.negative = q_negative;
+            q.trim();
+            *remainder = Integer(static_cast<long long>(rem));
+            remainder->negative = r_negative && rem != 0;
+            *quotient = std::move(q);
+            return;
+        }
+
+        std::size_t n = divisor.used, m = dividend.used - divisor.used;
+        int s = leading_zeros(divisor.digits()[n - 1]);
+        std::vector<limb> v(n), u(dividend.used + 1);
+        shift_left(v.data(), divisor.digits(), n, s);
+        u[dividend.used] = shift_left(u.data(), dividend.digits(), dividend.used, s);
+
+        Integer q;
+        q.reserve(m + 1);
+        auto qd = q.digits();
+        const wide base = wide(1) << limb_bits;
+        for (auto j = m + 1; j-- != 0;)
+        {
+            // 上位2limbを除数の最上位limbで割って商を推定する
+            wide num = (static_cast<wide>(u[j + n]) << limb_bits) | u[j + n - 1];
+            wide qhat = num / v[n - 1];
+            wide rhat = num % v[n - 1];
+            while (qhat >= base || qhat * v[n - 2] > ((rhat << limb_bits) | u[j + n - 2]))
+            {
+                --qhat;
+                rhat += v[n - 1];
+                if (rhat >= base)
+                {
+                    break;
+                }
+            }
+            // u[j..j+n] -= qhat * v
+            wide borrow = 0, carry = 0;
+            for (std::size_t i = 0; i != n; ++i)
+            {
+                carry += qhat * v[i];
+                wide d = static_cast<wide>(u[i + j]) - static_cast<limb>(carry) - borrow;
+                u[i + j] = static_cast<limb>(d);
+                borrow = (d >> limb_bits) & 1;
+                carry >>= limb_bits;
+            }
+            wide d = static_cast<wide>(u[j + n]) - carry - borrow;
+            u[j + n] = static_cast<limb>(d);
+            // 引きすぎた(推定が1大きかった)場合は1回分足し戻す
+            if ((d >> limb_bits) != 0)
+            {
+                --qhat;
+                wide c = 0;
+                for (std::size_t i = 0; i != n; ++i)
+                {
+                    c += static_cast<wide>(u[i + j]) + v[i];
+                    u[i + j] = static_cast<limb>(c);
+                    c >>= limb_bits;
+                }
+                u[j + n] += static_cast<limb>(c);
+            }
+            qd[j] = static_cast<limb>(qhat);
+        }
+        q.used = static_cast<std::uint32_t>(m + 1);
+        q.negative = q_negative;
+        q.trim();
+
+        Integer r;
+        r.reserve(n);
+        shift_right(r.digits(), u.data(), n, s);
+        r.used = static_cast<std::uint32_t>(n);
+        r.negative = r_negative;
+        r.trim();
+
+        *quotient = std::move(q);
+        *remainder = std::move(r);
+    }
+    // rにaをsビット左シフトしたものを入れ、溢れたlimbを返す(0 <= s < 32)
+    static limb shift_left(limb *r, const limb *a, std::size_t n, int s) noexcept
+    {
+        if (s == 0)
+        {
+            std::copy_n(a, n, r);
+            return 0;
+        }
+        limb carry = 0;
+        for (std::size_t i = 0; i != n; ++i)
+        {
+            limb x = a[i];
+            r[i] = (x << s) | carry;
+            carry = x >> (limb_bits - s);
+        }
+        return carry;
+    }
+    static void shift_right(limb *r, const limb *a, std::size_t n, int s) noexcept
+    {
+        if (s == 0)
+        {
+            std::copy_n(a, n, r);
+            return;
+        }
+        for (std::size_t i = 0; i != n; ++i)
+        {
+            r[i] = (a[i] >> s) | (i + 1 != n ? a[i + 1] << (limb_bits - s) : 0);
+        }
+    }
+};
+
+// 式テンプレート
+// a + b - c を評価せずに、項への参照(rvalueのIntegerは値)を木として持っておき、
+// Integerへの代入・構築の時に全ての項を1パスでまとめて計算する(Integer::evaluate)
+// 以前のように演算子ごとに一時オブジェクトを作ってデータを1回ずつ舐めることがない
+// 注意: autoで受けると式のまま残り、lvalueの項は参照で持っているので、その項より長く生かしてはいけない
+//   Integer c = a + b; // OK
+//   auto e = a + b;    // eは式。aやbが先に破棄されるとダングリング
+
+// lvalueの項
+struct integer_ref
+{
+    static constexpr bool is_integer_expression = true;
+    static constexpr std::size_t terms = 1;
+    const Integer *value;
+
+    void collect(integer_term *out, bool minus) const noexcept
+    {
+        *out = {value, minus};
+    }
+    Integer *owned() noexcept
+    {
+        return nullptr;
+    }
+};
+
+// rvalueの項。moveして持つのでヒープ確保は発生しない
+struct integer_value
+{
+    static constexpr bool is_integer_expression = true;
+    static constexpr std::size_t terms = 1;
+    Integer value;
+
+    void collect(integer_term *out, bool minus) const noexcept
+    {
+        *out = {&value, minus};
+    }
+    Integer *owned() noexcept
+    {
+        return &value;
+    }
+};
+
+// l + r (Minusならl - r)
+template <typename L, typename R, bool Minus>
+struct integer_sum
+{
+    static constexpr bool is_integer_expression = true;
+    static constexpr std::size_t terms = L::terms + R::terms;
+    L l;
+    R r;
+
+    void collect(integer_term *out, bool minus) const noexcept
+    {
+        l.collect(out, minus);
+        r.collect(out + L::terms, minus != Minus);
+    }
+    Integer *owned() noexcept
+    {
+        if (auto p = l.owned())
+        {
+            return p;
+        }
+        return r.owned();
+    }
+};
+
+// -e
+template <typename E>
+struct integer_negate
+{
+    static constexpr bool is_integer_expression = true;
+    static constexpr std::size_t terms = E::terms;
+    E e;
+
+    void collect(integer_term *out, bool minus) const noexcept
+    {
+        e.collect(out, !minus);
+    }
+    Integer *owned() noexcept
+    {
+        return e.owned();
+    }
+};
+
+template <typename T>
+concept integer_operand = std::same_as<std::remove_cvref_t<T>, Integer> || integer_expression<T>;
+
+// 項を式の木の葉に変換する
+template <integer_operand T>
+auto as_integer_node(T &&x)
+{
+    if constexpr (integer_expression<T>)
+    {
+        return std::remove_cvref_t<T>(std::forward<T>(x));
+    }
+    else if constexpr (std::is_lvalue_reference_v<T>)
+    {
+        return integer_ref{&x};
+    }
+    else
+    {
+        return integer_value{std::move(x)};
+    }
+}
+
+template <integer_operand L, integer_operand R>
+auto operator+(L &&l, R &&r)
+{
+    using node = integer_sum<decltype(as_integer_node(std::forward<L>(l))), decltype(as_integer_node(std::forward<R>(r))), false>;
+    return node{as_integer_node(std::forward<L>(l)), as_integer_node(std::forward<R>(r))};
+}
+template <integer_operand L, integer_operand R>
+auto operator-(L &&l, R &&r)
+{
+    using node = integer_sum<decltype(as_integer_node(std::forward<L>(l))), decltype(as_integer_node(std::forward<R>(r))), true>;
+    return node{as_integer_node(std::forward<L>(l)), as_integer_node(std::forward<R>(r))};
+}
+// Integer自身の単項-はメンバ関数(コピーまたはmoveして符号を反転するだけ)
+template <integer_expression E>
+auto operator-(E &&e)
+{
+    return integer_negate<std::remove_cvref_t<E>>{std::forward<E>(e)};
+}
+template <integer_expression E>
+std::ostream &operator<<(std::ostream &os, E &&e)
+{
+    return os << Integer(std::forward<E>(e));
+}
+
+// 掛け算と割り算は結果を別の領域に作るので、rvalue版は用意しない
+inline Integer operator*(const Integer &l, const Integer &r)
+{
+    auto result = l;
+    result *= r;
+    return result;
+}
+inline Integer operator/(const Integer &l, const Integer &r)
+{
+    auto result = l;
+    result /= r;
+    return result;
+}
+inline Integer operator%(const Integer &l, const Integer &r)
+{
+    auto result = l;
+    result %= r;
+    return result;
+}
+
+#endif
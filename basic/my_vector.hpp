@@ -0,0 +1,581 @@
+#ifndef MY_VECTOR_HPP
+#define MY_VECTOR_HPP
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "../trace/trace.hpp"
+
+template <typename T, typename Allocator = std::allocator<T>>
+class vector
+{
+public:
+    using value_type = T;
+    using pointer = T *;
+    using const_pointer = const T *;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    using iterator = pointer;
+    using const_iterator = const_pointer;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    vector(const allocator_type &alloc) noexcept : alloc(alloc)
+    {
+    }
+    vector() : vector(allocator_type()) {}
+    vector(size_type size, const allocator_type &alloc = allocator_type()) : vector(alloc)
+    {
+        resize(size);
+    }
+    vector(size_type size, const_reference value, const allocator_type &alloc = allocator_type()) : vector(alloc)
+    {
+        resize(size, value);
+    }
+    template <typename InputIterator>
+    vector(InputIterator first, InputIterator last, const allocator_type &alloc = allocator_type()) : vector(alloc)
+    {
+        reserve(std::distance(first, last));
+        for (auto i = first; i != last; ++i)
+        {
+            push_back(*i);
+        }
+    }
+    vector(std::initializer_list<value_type> init, const allocator_type &alloc = allocator_type()) : vector(alloc)
+    {
+        vector(std::begin(init), std::end(init), alloc);
+    }
+
+    // destructorはデフォルトだと空
+    // classのdestructor -> memberのfieldの定義逆順にdestructor の順で呼ばれる
+    // newで確保したオブジェクトは自前でdestructorやメモリ解放が必要
+    ~vector()
+    {
+        // 要素を末尾から先頭に向かう順番で破棄
+        clear();
+        // 生のメモリを解放
+        deallocate();
+    }
+
+    //   copy constructor
+    vector(const vector &r) : alloc(traits::select_on_container_copy_construction(r.alloc))
+    {
+        reserve(r.size());
+        for (auto dest = first, src = r.begin(), last = r.end();
+             src != last;
+             ++dest, ++src)
+        {
+            construct(dest, *src);
+        }
+        last = first + r.size();
+    }
+
+    // move constructor
+    vector(vector &&r) : first(r.first), last(r.last), reserved_last(r.reserved_last), alloc(r.alloc)
+    {
+        r.first = nullptr;
+        r.last = nullptr;
+        r.reserved_last = nullptr;
+    }
+
+    // copyは自分自身へのcopyをcheckする
+    vector &operator=(const vector &r)
+    {
+        if (this == &r)
+        {
+            return *this;
+        }
+        if (size() == r.size())
+        {
+            std::copy(r.begin(), r.end(), begin());
+        }
+        else if (capacity() >= r.size() && r.size() >= size())
+        {
+            std::copy(r.begin(), r.begin() + size(), begin());
+            for (auto src_iter = r.begin() + size(), src_end = r.end(); src_iter != src_end; ++src_iter, ++last)
+            {
+                construct(last, *src_iter);
+            }
+        }
+        else if (capacity() >= r.size() && r.size() < size())
+        {
+            std::copy(r.begin(), r.end(), begin());
+            resize(r.size());
+        }
+        else
+        {
+            clear();
+            reserve(r.size());
+
+            for (auto src_iter = r.begin(), src_end = r.end(), dest_iter = begin();
+                 src_iter != src_end; ++src_iter, ++dest_iter, ++last)
+            {
+                construct(dest_iter, *src_iter);
+            }
+        }
+        return *this;
+    }
+
+    // moveは自分自身へのmoveはcheckしないのが通例
+    vector &operator=(vector &&r)
+    {
+        clear();
+        deallocate();
+        alloc = r.alloc;
+        first = r.first;
+        last = r.last;
+        reserved_last = r.reserved_last;
+        r.first = nullptr;
+        r.last = nullptr;
+        r.reserved_last = nullptr;
+        return *this;
+    }
+
+    void resize(size_type sz)
+    {
+        if (sz < size())
+        {
+            auto diff = size() - sz;
+            destroy_until(rbegin() + diff);
+            last = first + sz;
+        }
+        else if (sz > size())
+        {
+            reserve(sz);
+            for (; last != reserved_last; ++last)
+            {
+                construct(last);
+            }
+        }
+    }
+    void resize(size_type sz, const_reference value)
+    {
+        if (sz < size())
+        {
+            auto diff = size() - sz;
+            destroy_until(rbegin() + diff);
+            last = first + sz;
+        }
+        else if (sz > size())
+        {
+            reserve(sz);
+            for (; last != reserved_last; ++last)
+            {
+                construct(last, value);
+            }
+        }
+    }
+
+    void shrink_to_fit()
+    {
+        if (size() == capacity())
+        {
+            return;
+        }
+        reallocate(size(), [&]
+                   {
+                       auto ptr = allocate(size());
+                       auto current_size = size();
+                       for (auto raw_ptr = ptr, iter = begin(), iter_end = end();
+                            iter != iter_end;
+                            ++iter, ++raw_ptr)
+                       {
+                           construct(raw_ptr, *iter);
+                       }
+                       clear();
+                       deallocate();
+                       first = ptr;
+                       last = ptr + current_size;
+                       reserved_last = last; });
+    }
+    // v.push_back(std::string("b"));
+    // push_backの場合は値コピーまたはムーブ処理が発生する
+    // 一時オブジェクトstd::string("b")のデストラクタも呼ばれる
+    void push_back(const_reference value)
+    {
+        if (size() + 1 > capacity())
+        {
+            auto c = size();
+            if (c == 0)
+            {
+                c = 1;
+            }
+            else
+            {
+                c *= 2;
+            }
+            reserve(c);
+        }
+        construct(last, value);
+        ++last;
+    }
+
+    reference operator[](std::size_t i)
+    {
+        return first[i];
+    }
+    const_reference operator[](std::size_t i) const
+    {
+        return first[i];
+    }
+    reference at(std::size_t i)
+    {
+        if (i >= size())
+        {
+            throw std::out_of_range("index is out of range.");
+        }
+        return first[i];
+    }
+    const_reference at(std::size_t i) const
+    {
+        if (i >= size())
+        {
+            throw std::out_of_range("index is out of range.");
+        }
+        return first[i];
+    }
+
+    iterator begin() noexcept
+    {
+        return first;
+    }
+    iterator end() noexcept
+    {
+        return last;
+    }
+    const_iterator begin() const noexcept
+    {
+        return first;
+    }
+    const_iterator end() const noexcept
+    {
+        return last;
+    }
+    const_iterator cbegin() const noexcept
+    {
+        return first;
+    }
+    const_iterator cend() const noexcept
+    {
+        return last;
+    }
+    reverse_iterator rbegin() noexcept
+    {
+        return reverse_iterator{last};
+    }
+    reverse_iterator rend() noexcept
+    {
+        return reverse_iterator{first};
+    }
+    size_type size() const noexcept
+    {
+        return end() - begin();
+        // return std::distance(begin(),end());
+    }
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+    size_type capacity() const noexcept
+    {
+        return reserved_last - first;
+    }
+    reference front()
+    {
+        return *first;
+    }
+    reference front() const
+    {
+        return *first;
+    }
+    reference back()
+    {
+        return *(last - 1);
+    }
+    reference back() const
+    {
+        return *(last - 1);
+    }
+    void clear() noexcept
+    {
+        destroy_until(rend());
+    }
+    allocator_type get_allocator() const noexcept
+    {
+        return alloc;
+    }
+
+    void reserve(size_type sz)
+    {
+        if (sz <= capacity())
+        {
+            return;
+        }
+        TRACE_SCOPE("vector::reserve");
+        reallocate(sz, [&]
+                   {
+                       auto ptr = allocate(sz);
+
+                       auto old_first = first;
+                       auto old_last = last;
+                       auto old_capacity = capacity();
+
+                       first = ptr;
+                       last = first;
+                       reserved_last = first + sz;
+
+                       for (auto old_iter = old_first; old_iter != old_last; ++old_iter, ++last)
+                       {
+                           construct(last, std::move(*old_iter));
+                       }
+
+                       for (auto riter = reverse_iterator(old_last), rend = reverse_iterator(old_first); riter != rend; ++riter)
+                       {
+                           destroy(&*riter);
+                       }
+
+                       traits::deallocate(alloc, old_first, old_capacity); });
+    }
+
+private:
+    pointer first = nullptr;
+    pointer last = nullptr;
+    pointer reserved_last = nullptr;
+    allocator_type alloc;
+    using traits = std::allocator_traits<allocator_type>;
+
+    pointer allocate(size_type n)
+    {
+        return traits::allocate(alloc, n);
+    }
+    void deallocate()
+    {
+        traits::deallocate(alloc, first, capacity());
+    }
+    void construct(pointer ptr)
+    {
+        traits::construct(alloc, ptr);
+    }
+    void construct(pointer ptr, const_reference value)
+    {
+        traits::construct(alloc, ptr, value);
+    }
+    void construct(pointer ptr, value_type &&value)
+    {
+        traits::construct(alloc, ptr, std::move(value));
+    }
+    void destroy(pointer ptr)
+    {
+        traits::destroy(alloc, ptr);
+    }
+    void destroy_until(reverse_iterator rend)
+    {
+        for (auto riter = rbegin(); riter != rend; ++riter, --last)
+        {
+            destroy(&*riter);
+        }
+    }
+
+    // 確保し直し(reserve, shrink_to_fit)の本体fを実行する
+    // アロケータがon_reallocateを持っていれば(tracking_allocator等)、かかった時間と前後の容量を通知する
+    template <typename F>
+    void reallocate(size_type new_capacity, F f)
+    {
+        if constexpr (requires(allocator_type &a) { a.on_reallocate(size_type(), size_type(), size_type(), std::chrono::nanoseconds()); })
+        {
+            auto old_capacity = capacity();
+            auto start = std::chrono::steady_clock::now();
+            f();
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            alloc.on_reallocate(size(), old_capacity, new_capacity, elapsed);
+        }
+        else
+        {
+            f();
+        }
+    }
+
+};
+
+// 呼び出し元(タグ)ごとのアロケーション統計
+// 複数スレッドから同じタグで使われてもよいよう全てatomicにしている
+struct allocation_stats
+{
+    std::atomic<std::size_t> allocations{0};
+    std::atomic<std::size_t> deallocations{0};
+    std::atomic<std::size_t> allocated_bytes{0};
+    std::atomic<std::size_t> live_bytes{0};
+    std::atomic<std::size_t> peak_live_bytes{0};
+    // 以下はコンテナからon_reallocateで通知されるもの
+    std::atomic<std::size_t> grows{0};
+    std::atomic<std::size_t> shrinks{0};
+    std::atomic<std::size_t> reallocation_ns{0};
+    // 再確保直後の(capacity - size)のバイト数の最大値。確保したのに使われていない領域
+    std::atomic<std::size_t> peak_waste_bytes{0};
+
+    static void update_max(std::atomic<std::size_t> &target, std::size_t value) noexcept
+    {
+        auto current = target.load(std::memory_order_relaxed);
+        while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+};
+
+// タグ名からallocation_statsへの対応表
+// std::mapの要素はアドレスが変わらないので、アロケータはポインタを持っておけばよい
+class allocation_registry
+{
+public:
+    static allocation_registry &instance()
+    {
+        static allocation_registry registry;
+        return registry;
+    }
+    allocation_stats &get(const std::string &tag)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats[tag];
+    }
+    // {"tag": {"allocations": ..., ...}, ...} の形式で出力する
+    void dump_json(std::ostream &os)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        os << '{';
+        bool first_tag = true;
+        for (auto &[tag, s] : stats)
+        {
+            if (!first_tag)
+            {
+                os << ',';
+            }
+            first_tag = false;
+            write_json_string(os, tag);
+            os << ":{"
+               << "\"allocations\":" << s.allocations.load()
+               << ",\"deallocations\":" << s.deallocations.load()
+               << ",\"allocated_bytes\":" << s.allocated_bytes.load()
+               << ",\"live_bytes\":" << s.live_bytes.load()
+               << ",\"peak_live_bytes\":" << s.peak_live_bytes.load()
+               << ",\"grows\":" << s.grows.load()
+               << ",\"shrinks\":" << s.shrinks.load()
+               << ",\"reallocation_ns\":" << s.reallocation_ns.load()
+               << ",\"peak_waste_bytes\":" << s.peak_waste_bytes.load()
+               << '}';
+        }
+        os << '}';
+    }
+
+private:
+    std::mutex mutex;
+    std::map<std::string, allocation_stats> stats;
+
+    // タグは利用者が付ける任意の文字列なので、"と\と制御文字をエスケープする
+    static void write_json_string(std::ostream &os, const std::string &s)
+    {
+        static constexpr char hex[] = "0123456789abcdef";
+        os << '"';
+        for (char c : s)
+        {
+            auto u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\')
+            {
+                os << '\\' << c;
+            }
+            else if (u < 0x20)
+            {
+                os << "\\u00" << hex[u >> 4] << hex[u & 0xf];
+            }
+            else
+            {
+                os << c;
+            }
+        }
+        os << '"';
+    }
+};
+
+// 計測用のアロケータアダプタ。vector<T, tracking_allocator<T>>のように使う
+// 実際の確保はUnderlying(デフォルトはstd::allocator)に任せ、統計をタグごとに記録する
+//   vector<int, tracking_allocator<int>> v(tracking_allocator<int>("orders"));
+template <typename T, typename Underlying = std::allocator<T>>
+class tracking_allocator
+{
+    template <typename U, typename V>
+    friend class tracking_allocator;
+
+public:
+    using value_type = T;
+    template <typename U>
+    struct rebind
+    {
+        using other = tracking_allocator<U, typename std::allocator_traits<Underlying>::template rebind_alloc<U>>;
+    };
+
+    tracking_allocator() : tracking_allocator("default") {}
+    explicit tracking_allocator(const std::string &tag, const Underlying &underlying = Underlying())
+        : underlying(underlying), stats(&allocation_registry::instance().get(tag))
+    {
+    }
+    template <typename U, typename V>
+    tracking_allocator(const tracking_allocator<U, V> &r) : underlying(r.underlying), stats(r.stats)
+    {
+    }
+
+    T *allocate(std::size_t n)
+    {
+        auto p = std::allocator_traits<Underlying>::allocate(underlying, n);
+        auto bytes = n * sizeof(T);
+        stats->allocations.fetch_add(1, std::memory_order_relaxed);
+        stats->allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        auto live = stats->live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        allocation_stats::update_max(stats->peak_live_bytes, live);
+        return p;
+    }
+    void deallocate(T *p, std::size_t n)
+    {
+        // vectorは未確保の状態でもdeallocate(nullptr, 0)を呼ぶので数えない
+        if (p == nullptr)
+        {
+            return;
+        }
+        std::allocator_traits<Underlying>::deallocate(underlying, p, n);
+        stats->deallocations.fetch_add(1, std::memory_order_relaxed);
+        stats->live_bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+    }
+
+    // vector::reserve, shrink_to_fitから呼ばれる
+    void on_reallocate(std::size_t size, std::size_t old_capacity, std::size_t new_capacity, std::chrono::nanoseconds elapsed)
+    {
+        (new_capacity > old_capacity ? stats->grows : stats->shrinks).fetch_add(1, std::memory_order_relaxed);
+        stats->reallocation_ns.fetch_add(static_cast<std::size_t>(elapsed.count()), std::memory_order_relaxed);
+        allocation_stats::update_max(stats->peak_waste_bytes, (new_capacity - size) * sizeof(T));
+    }
+
+    const allocation_stats &statistics() const noexcept
+    {
+        return *stats;
+    }
+
+    template <typename U, typename V>
+    bool operator==(const tracking_allocator<U, V> &r) const noexcept
+    {
+        return stats == r.stats && underlying == r.underlying;
+    }
+
+private:
+    Underlying underlying;
+    allocation_stats *stats;
+};
+
+#endif
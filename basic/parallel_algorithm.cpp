@@ -0,0 +1,487 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// vectorやarrayのイテレータ範囲(ランダムアクセス)に対する並列アルゴリズム
+// * 内部のスレッドプールでfork-joinする。呼び出したスレッドも処理に参加する
+// * 1チャンクがL2キャッシュに収まる程度の大きさになるよう分割し、小さい入力は逐次版にフォールバックする
+namespace parallel
+{
+    // チャンクの大きさの目安。L2の半分程度(256KiB)に収まるようにする
+    constexpr std::size_t chunk_bytes = 256 * 1024;
+    // これより要素数が少なければスレッドを使わない
+    constexpr std::size_t sequential_cutoff = 1 << 14;
+
+    class thread_pool
+    {
+    public:
+        explicit thread_pool(std::size_t n = std::thread::hardware_concurrency())
+        {
+            // 呼び出しスレッドも働くのでワーカーは1つ少なくてよい
+            for (std::size_t i = 1; i < n; ++i)
+            {
+                workers.emplace_back([this]
+                                     { work(); });
+            }
+        }
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            wake.notify_all();
+            for (auto &t : workers)
+            {
+                t.join();
+            }
+        }
+        thread_pool(const thread_pool &) = delete;
+        thread_pool &operator=(const thread_pool &) = delete;
+
+        std::size_t size() const noexcept
+        {
+            return workers.size() + 1;
+        }
+
+        // f(0), f(1), ..., f(count - 1)を並列に実行し、全て終わるまで待つ
+        // 同時に投入できるジョブは1つだけなので、複数スレッドからの呼び出しは直列化される
+        // fが例外を投げたら残りのfは呼ばず、全てのスレッドがjobから抜けてから最初の例外を投げ直す
+        // fの中から同じプールのrunを呼ぶと、そのスレッドで逐次に実行する(submitを待つとデッドロックするので)
+        // (プールAのfからBのrunを、Bのfから再びAのrunを呼ぶような入れ子は扱わない)
+        template <typename F>
+        void run(std::size_t count, F f)
+        {
+            if (running == this)
+            {
+                for (std::size_t i = 0; i != count; ++i)
+                {
+                    f(i);
+                }
+                return;
+            }
+            std::lock_guard<std::mutex> serialize(submit);
+            std::function<void(std::size_t)> task = std::ref(f);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job = &task;
+                job_count = count;
+                next = 0;
+                done = 0;
+                failed = false;
+                ++generation;
+            }
+            wake.notify_all();
+            auto outer = std::exchange(running, this);
+            drain(task);
+            running = outer;
+
+            std::exception_ptr e;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [this]
+                              { return done == job_count && active == 0; });
+                job = nullptr;
+                e = std::exchange(error, nullptr);
+            }
+            if (e)
+            {
+                std::rethrow_exception(e);
+            }
+        }
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex submit;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        std::function<void(std::size_t)> *job = nullptr;
+        std::size_t job_count = 0;
+        std::size_t generation = 0;
+        // 処理中のワーカー数。0になるまではjobを破棄できない
+        std::size_t active = 0;
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        // 例外が出たら、残りの番号は取るだけで呼ばずにdoneへ数える
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        bool stop = false;
+        // このスレッドが今jobを実行しているプール
+        static inline thread_local const thread_pool *running = nullptr;
+
+        void drain(std::function<void(std::size_t)> &task) noexcept
+        {
+            std::size_t n = 0;
+            for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < job_count;)
+            {
+                if (!failed.load(std::memory_order_relaxed))
+                {
+                    try
+                    {
+                        task(i);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error)
+                        {
+                            error = std::current_exception();
+                        }
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                }
+                ++n;
+            }
+            if (n != 0 && done.fetch_add(n, std::memory_order_acq_rel) + n == job_count)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+
+        void work()
+        {
+            running = this;
+            std::size_t seen = 0;
+            while (true)
+            {
+                std::function<void(std::size_t)> *task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&]
+                              { return stop || (job != nullptr && generation != seen); });
+                    if (stop)
+                    {
+                        return;
+                    }
+                    seen = generation;
+                    task = job;
+                    ++active;
+                }
+                drain(*task);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --active;
+                }
+                finished.notify_all();
+            }
+        }
+    };
+
+    // プロセス全体で共有するプール
+    inline thread_pool &default_pool()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+
+    // [0, n)をチャンクに分けた時のチャンク数
+    template <typename T>
+    std::size_t chunk_count(std::size_t n, const thread_pool &pool)
+    {
+        std::size_t per_chunk = std::max<std::size_t>(chunk_bytes / sizeof(T), 1);
+        std::size_t chunks = (n + per_chunk - 1) / per_chunk;
+        // 負荷の偏りをならすため、スレッド数の数倍には分ける
+        return std::clamp<std::size_t>(chunks, std::min(n, pool.size() * 4), n);
+    }
+
+    // i番目のチャンクの範囲[begin, end)
+    inline std::pair<std::size_t, std::size_t> chunk_range(std::size_t n, std::size_t chunks, std::size_t i)
+    {
+        return {n * i / chunks, n * (i + 1) / chunks};
+    }
+
+    template <typename RandomIt, typename F>
+    void for_each(thread_pool &pool, RandomIt first, RandomIt last, F f)
+    {
+        using T = typename std::iterator_traits<RandomIt>::value_type;
+        std::size_t n = last - first;
+        if (n < sequential_cutoff || pool.size() == 1)
+        {
+            std::for_each(first, last, f);
+            return;
+        }
+        auto chunks = chunk_count<T>(n, pool);
+        pool.run(chunks, [&](std::size_t i)
+                 {
+                     auto [b, e] = chunk_range(n, chunks, i);
+                     std::for_each(first + b, first + e, f); });
+    }
+
+    // reduceは結合則を満たすこと(チャンクごとの部分和を最後にまとめるため)
+    template <typename RandomIt, typename T, typename Reduce, typename Transform>
+    T transform_reduce(thread_pool &pool, RandomIt first, RandomIt last, T init, Reduce reduce, Transform transform)
+    {
+        using V = typename std::iterator_traits<RandomIt>::value_type;
+        std::size_t n = last - first;
+        if (n < sequential_cutoff || pool.size() == 1)
+        {
+            return std::transform_reduce(first, last, init, reduce, transform);
+        }
+        auto chunks = chunk_count<V>(n, pool);
+        std::vector<std::optional<T>> partial(chunks);
+        pool.run(chunks, [&](std::size_t i)
+                 {
+                     auto [b, e] = chunk_range(n, chunks, i);
+                     // 各チャンクの先頭要素を初期値にし、部分和はoptionalに置くので、Tにデフォルト値が不要
+                     T acc = transform(first[b]);
+                     for (auto j = b + 1; j != e; ++j)
+                     {
+                         acc = reduce(std::move(acc), transform(first[j]));
+                     }
+                     partial[i].emplace(std::move(acc)); });
+        for (auto &p : partial)
+        {
+            init = reduce(std::move(init), std::move(*p));
+        }
+        return init;
+    }
+
+    // 2パスで計算する
+    // 1. チャンクごとの総和を並列に求める
+    // 2. 総和を逐次に累積して各チャンクの先頭のオフセットを求め、チャンクごとにscanし直す
+    template <typename RandomIt, typename OutputIt, typename Op = std::plus<>>
+    OutputIt inclusive_scan(thread_pool &pool, RandomIt first, RandomIt last, OutputIt d_first, Op op = Op())
+    {
+        using T = typename std::iterator_traits<RandomIt>::value_type;
+        std::size_t n = last - first;
+        if (n < sequential_cutoff || pool.size() == 1)
+        {
+            return std::inclusive_scan(first, last, d_first, op);
+        }
+        auto chunks = chunk_count<T>(n, pool);
+        std::vector<std::optional<T>> sums(chunks);
+        pool.run(chunks, [&](std::size_t i)
+                 {
+                     auto [b, e] = chunk_range(n, chunks, i);
+                     T acc = first[b];
+                     for (auto j = b + 1; j != e; ++j)
+                     {
+                         acc = op(std::move(acc), first[j]);
+                     }
+                     sums[i].emplace(std::move(acc)); });
+        for (std::size_t i = 1; i < chunks; ++i)
+        {
+            sums[i] = op(*sums[i - 1], *sums[i]);
+        }
+        pool.run(chunks, [&](std::size_t i)
+                 {
+                     auto [b, e] = chunk_range(n, chunks, i);
+                     if (i == 0)
+                     {
+                         std::inclusive_scan(first + b, first + e, d_first + b, op);
+                     }
+                     else
+                     {
+                         std::inclusive_scan(first + b, first + e, d_first + b, op, *sums[i - 1]);
+                     } });
+        return d_first + n;
+    }
+
+    // マージソート
+    // チャンクごとにstd::sortし、隣り合う区間を並列にマージする段を区間が1つになるまで繰り返す
+    // マージ先は作業領域とのピンポンにして、最後に元の範囲に戻っていなければコピーする
+    template <typename RandomIt, typename Compare = std::less<>>
+    void sort(thread_pool &pool, RandomIt first, RandomIt last, Compare comp = Compare())
+    {
+        using T = typename std::iterator_traits<RandomIt>::value_type;
+        std::size_t n = last - first;
+        if (n < sequential_cutoff || pool.size() == 1)
+        {
+            std::sort(first, last, comp);
+            return;
+        }
+        auto chunks = chunk_count<T>(n, pool);
+        std::vector<std::size_t> bounds(chunks + 1);
+        for (std::size_t i = 0; i <= chunks; ++i)
+        {
+            bounds[i] = n * i / chunks;
+        }
+        pool.run(chunks, [&](std::size_t i)
+                 { std::sort(first + bounds[i], first + bounds[i + 1], comp); });
+
+        std::vector<T> buffer(first, last);
+        bool in_buffer = false;
+        while (bounds.size() > 2)
+        {
+            std::size_t runs = bounds.size() - 1;
+            std::size_t pairs = (runs + 1) / 2;
+            auto merge = [&](auto src, auto dst)
+            {
+                pool.run(pairs, [&](std::size_t p)
+                         {
+                             auto b = bounds[2 * p];
+                             auto m = bounds[std::min(2 * p + 1, runs)];
+                             auto e = bounds[std::min(2 * p + 2, runs)];
+                             std::merge(std::make_move_iterator(src + b), std::make_move_iterator(src + m),
+                                        std::make_move_iterator(src + m), std::make_move_iterator(src + e),
+                                        dst + b, comp); });
+            };
+            if (in_buffer)
+            {
+                merge(buffer.begin(), first);
+            }
+            else
+            {
+                merge(first, buffer.begin());
+            }
+            in_buffer = !in_buffer;
+
+            std::vector<std::size_t> merged;
+            for (std::size_t i = 0; i < bounds.size(); i += 2)
+            {
+                merged.push_back(bounds[i]);
+            }
+            if (merged.back() != n)
+            {
+                merged.push_back(n);
+            }
+            bounds = std::move(merged);
+        }
+        if (in_buffer)
+        {
+            parallel::for_each(pool, buffer.begin(), buffer.end(), [&](T &x)
+                               { first[&x - buffer.data()] = std::move(x); });
+        }
+    }
+
+    // プール省略版
+    template <typename RandomIt, typename F>
+    void for_each(RandomIt first, RandomIt last, F f)
+    {
+        for_each(default_pool(), first, last, f);
+    }
+    template <typename RandomIt, typename T, typename Reduce, typename Transform>
+    T transform_reduce(RandomIt first, RandomIt last, T init, Reduce reduce, Transform transform)
+    {
+        return transform_reduce(default_pool(), first, last, init, reduce, transform);
+    }
+    template <typename RandomIt, typename OutputIt, typename Op = std::plus<>>
+    OutputIt inclusive_scan(RandomIt first, RandomIt last, OutputIt d_first, Op op = Op())
+    {
+        return inclusive_scan(default_pool(), first, last, d_first, op);
+    }
+    template <typename RandomIt, typename Compare = std::less<>>
+    void sort(RandomIt first, RandomIt last, Compare comp = Compare())
+    {
+        sort(default_pool(), first, last, comp);
+    }
+}
+
+// 逐次版との比較
+template <typename F>
+double measure(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t n = argc > 1 ? std::stoul(argv[1]) : 10'000'000;
+    std::size_t threads = argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+    parallel::thread_pool pool(threads);
+    std::cout << "threads: " << pool.size() << " n: " << n << std::endl;
+
+    std::mt19937_64 rng(1);
+    std::vector<long long> v(n);
+    for (auto &x : v)
+    {
+        x = static_cast<long long>(rng() % 1000);
+    }
+    bool ok = true;
+
+    {
+        auto w = v, u = v;
+        auto f = [](long long &x)
+        { x = x * 3 + 1; };
+        auto seq = measure([&]
+                           { std::for_each(w.begin(), w.end(), f); });
+        auto par = measure([&]
+                           { parallel::for_each(pool, u.begin(), u.end(), f); });
+        ok &= w == u;
+        std::cout << "for_each         seq " << seq << "ms par " << par << "ms" << std::endl;
+    }
+    {
+        long long s1 = 0, s2 = 0;
+        auto sq = [](long long x)
+        { return x * x; };
+        auto seq = measure([&]
+                           { s1 = std::transform_reduce(v.begin(), v.end(), 0LL, std::plus<>(), sq); });
+        auto par = measure([&]
+                           { s2 = parallel::transform_reduce(pool, v.begin(), v.end(), 0LL, std::plus<>(), sq); });
+        ok &= s1 == s2;
+        std::cout << "transform_reduce seq " << seq << "ms par " << par << "ms" << std::endl;
+    }
+    {
+        std::vector<long long> w(n), u(n);
+        auto seq = measure([&]
+                           { std::inclusive_scan(v.begin(), v.end(), w.begin()); });
+        auto par = measure([&]
+                           { parallel::inclusive_scan(pool, v.begin(), v.end(), u.begin()); });
+        ok &= w == u;
+        std::cout << "inclusive_scan   seq " << seq << "ms par " << par << "ms" << std::endl;
+    }
+    {
+        auto w = v, u = v;
+        auto seq = measure([&]
+                           { std::sort(w.begin(), w.end()); });
+        auto par = measure([&]
+                           { parallel::sort(pool, u.begin(), u.end()); });
+        ok &= w == u;
+        std::cout << "sort             seq " << seq << "ms par " << par << "ms" << std::endl;
+    }
+    {
+        // 例外は全てのスレッドが抜けてから呼び出し元に投げ直され、プールはその後も使える
+        bool caught = false;
+        try
+        {
+            pool.run(1000, [](std::size_t i)
+                     {
+                         if (i % 97 == 13)
+                         {
+                             throw std::runtime_error("task failed");
+                         } });
+        }
+        catch (const std::runtime_error &)
+        {
+            caught = true;
+        }
+        // 入れ子のrunはその場で逐次に実行する
+        std::atomic<std::size_t> inner{0};
+        pool.run(pool.size() * 2, [&](std::size_t)
+                 { pool.run(10, [&](std::size_t)
+                            { inner.fetch_add(1, std::memory_order_relaxed); }); });
+        // デフォルト構築できない型でも集計できる
+        struct total
+        {
+            long long value;
+            explicit total(long long v) : value(v) {}
+        };
+        auto t = parallel::transform_reduce(
+            pool, v.begin(), v.end(), total(0), [](total l, total r)
+            { return total(l.value + r.value); },
+            [](long long x)
+            { return total(x); });
+        ok &= caught && inner == pool.size() * 20 && t.value == std::accumulate(v.begin(), v.end(), 0LL);
+        std::cout << "exception: " << caught << " nested: " << inner << std::endl;
+    }
+    std::cout << (ok ? "all ok" : "mismatch") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,437 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <typeinfo>
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // ftruncate, close
+
+// my_vector.cppのvectorと同じインターフェースで、要素をファイルにmmapして永続化するvector
+// 起動時に元データをパースし直す代わりに、ファイルをmmapするだけ(O(1))で前回の状態から再開できる
+// * 要素はtrivially copyableに限る(ポインタを含む型はプロセスをまたぐと意味をなさない)
+// * ファイルの先頭にheaderを置き、その後ろに要素を連続して並べる
+// * countはheader(=mmapした領域)に直接書くので、push_backした時点でページキャッシュには反映されている
+//   ディスクへの書き出しを保証したいタイミングでsync()を呼ぶ(チェックポイント)
+template <typename T>
+class persistent_vector
+{
+    static_assert(std::is_trivially_copyable_v<T>, "persistent_vector requires trivially copyable T");
+
+public:
+    using value_type = T;
+    using pointer = T *;
+    using const_pointer = const T *;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    using iterator = pointer;
+    using const_iterator = const_pointer;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    // ファイルが存在しなければ作成し、存在すればheaderを検証してそのままmmapする
+    explicit persistent_vector(const char *path, size_type initial_capacity = 16)
+    {
+        fd = ::open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "open");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            auto e = errno;
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), "fstat");
+        }
+        try
+        {
+            if (st.st_size == 0)
+            {
+                create(initial_capacity == 0 ? 1 : initial_capacity);
+            }
+            else
+            {
+                open_existing(static_cast<size_type>(st.st_size));
+            }
+        }
+        catch (...)
+        {
+            unmap();
+            ::close(fd);
+            throw;
+        }
+    }
+
+    ~persistent_vector()
+    {
+        unmap();
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+
+    // 同じファイルを2つのインスタンスがmapするとcountが食い違うのでcopyは禁止
+    persistent_vector(const persistent_vector &) = delete;
+    persistent_vector &operator=(const persistent_vector &) = delete;
+
+    persistent_vector(persistent_vector &&r) noexcept : fd(r.fd), mapped(r.mapped), mapped_size(r.mapped_size)
+    {
+        r.fd = -1;
+        r.mapped = nullptr;
+        r.mapped_size = 0;
+    }
+    persistent_vector &operator=(persistent_vector &&r) noexcept
+    {
+        unmap();
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        fd = r.fd;
+        mapped = r.mapped;
+        mapped_size = r.mapped_size;
+        r.fd = -1;
+        r.mapped = nullptr;
+        r.mapped_size = 0;
+        return *this;
+    }
+
+    void push_back(const_reference value)
+    {
+        if (size() + 1 > capacity())
+        {
+            // vectorと同じく倍々で伸ばす。伸ばすたびにftruncate + mmapし直すので回数は少ない方がよい
+            reserve(capacity() * 2);
+        }
+        // trivially copyableなのでconstructではなくmemcpyで十分
+        std::memcpy(static_cast<void *>(data() + size()), &value, sizeof(T));
+        ++head()->count;
+    }
+    void pop_back()
+    {
+        --head()->count;
+    }
+
+    void resize(size_type sz, const_reference value = value_type())
+    {
+        if (sz > size())
+        {
+            reserve(sz);
+            for (auto p = data() + size(), e = data() + sz; p != e; ++p)
+            {
+                std::memcpy(static_cast<void *>(p), &value, sizeof(T));
+            }
+        }
+        head()->count = sz;
+    }
+
+    // ファイルを伸ばしてmmapし直す。vectorと同様に既存のポインタ・イテレータは無効になる
+    void reserve(size_type sz)
+    {
+        if (sz <= capacity())
+        {
+            return;
+        }
+        remap(sz);
+    }
+
+    void shrink_to_fit()
+    {
+        if (size() == capacity())
+        {
+            return;
+        }
+        remap(size() == 0 ? 1 : size());
+    }
+
+    // チェックポイント。ここまでのpush_back等がディスクに書き出されたことを保証する
+    void sync()
+    {
+        if (::msync(mapped, mapped_size, MS_SYNC) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "msync");
+        }
+    }
+
+    reference operator[](std::size_t i)
+    {
+        return data()[i];
+    }
+    const_reference operator[](std::size_t i) const
+    {
+        return data()[i];
+    }
+    reference at(std::size_t i)
+    {
+        if (i >= size())
+        {
+            throw std::out_of_range("index is out of range.");
+        }
+        return data()[i];
+    }
+    const_reference at(std::size_t i) const
+    {
+        if (i >= size())
+        {
+            throw std::out_of_range("index is out of range.");
+        }
+        return data()[i];
+    }
+
+    iterator begin() noexcept
+    {
+        return data();
+    }
+    iterator end() noexcept
+    {
+        return data() + size();
+    }
+    const_iterator begin() const noexcept
+    {
+        return data();
+    }
+    const_iterator end() const noexcept
+    {
+        return data() + size();
+    }
+    const_iterator cbegin() const noexcept
+    {
+        return begin();
+    }
+    const_iterator cend() const noexcept
+    {
+        return end();
+    }
+    reverse_iterator rbegin() noexcept
+    {
+        return reverse_iterator{end()};
+    }
+    reverse_iterator rend() noexcept
+    {
+        return reverse_iterator{begin()};
+    }
+    size_type size() const noexcept
+    {
+        return head()->count;
+    }
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+    size_type capacity() const noexcept
+    {
+        return head()->capacity;
+    }
+    reference front()
+    {
+        return *begin();
+    }
+    const_reference front() const
+    {
+        return *begin();
+    }
+    reference back()
+    {
+        return *(end() - 1);
+    }
+    const_reference back() const
+    {
+        return *(end() - 1);
+    }
+    void clear() noexcept
+    {
+        head()->count = 0;
+    }
+    pointer data() noexcept
+    {
+        return reinterpret_cast<pointer>(static_cast<char *>(mapped) + data_offset);
+    }
+    const_pointer data() const noexcept
+    {
+        return reinterpret_cast<const_pointer>(static_cast<const char *>(mapped) + data_offset);
+    }
+
+private:
+    // ファイル先頭のheader。固定長にしておき、要素はdata_offsetから始まる
+    struct header
+    {
+        char magic[8];
+        std::uint64_t type_tag;
+        std::uint64_t elem_size;
+        std::uint64_t count;
+        std::uint64_t capacity;
+    };
+    static constexpr char file_magic[8] = {'P', 'V', 'E', 'C', 'T', '0', '0', '1'};
+    // mmapの先頭はページ境界なので、headerの後ろをalignof(T)に揃えれば要素も正しく整列する
+    static constexpr size_type data_offset = (sizeof(header) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+    int fd = -1;
+    void *mapped = nullptr;
+    size_type mapped_size = 0;
+
+    header *head() noexcept
+    {
+        return static_cast<header *>(mapped);
+    }
+    const header *head() const noexcept
+    {
+        return static_cast<const header *>(mapped);
+    }
+
+    // 別の型で作ったファイルを誤って開かないための識別子
+    // 型名(mangled name)のFNV-1aハッシュ。同じコンパイラでビルドしたバイナリ間でのみ安定
+    static std::uint64_t type_tag() noexcept
+    {
+        std::uint64_t h = 14695981039346656037ull;
+        for (auto p = typeid(T).name(); *p; ++p)
+        {
+            h ^= static_cast<unsigned char>(*p);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static size_type file_size_for(size_type cap) noexcept
+    {
+        return data_offset + cap * sizeof(T);
+    }
+
+    void *map_file(size_type sz)
+    {
+        void *p = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::generic_category(), "mmap");
+        }
+        return p;
+    }
+    void map(size_type sz)
+    {
+        mapped = map_file(sz);
+        mapped_size = sz;
+    }
+    void unmap() noexcept
+    {
+        if (mapped != nullptr)
+        {
+            ::munmap(mapped, mapped_size);
+            mapped = nullptr;
+            mapped_size = 0;
+        }
+    }
+    void truncate(size_type sz)
+    {
+        if (::ftruncate(fd, static_cast<off_t>(sz)) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "ftruncate");
+        }
+    }
+
+    void create(size_type cap)
+    {
+        truncate(file_size_for(cap));
+        map(file_size_for(cap));
+        auto h = head();
+        std::memcpy(h->magic, file_magic, sizeof(file_magic));
+        h->type_tag = type_tag();
+        h->elem_size = sizeof(T);
+        h->count = 0;
+        h->capacity = cap;
+    }
+
+    void open_existing(size_type file_size)
+    {
+        if (file_size < sizeof(header))
+        {
+            throw std::runtime_error("persistent_vector: file is too small.");
+        }
+        map(file_size);
+        auto h = head();
+        if (std::memcmp(h->magic, file_magic, sizeof(file_magic)) != 0)
+        {
+            throw std::runtime_error("persistent_vector: bad magic.");
+        }
+        if (h->type_tag != type_tag() || h->elem_size != sizeof(T))
+        {
+            throw std::runtime_error("persistent_vector: element type mismatch.");
+        }
+        if (h->count > h->capacity || file_size < file_size_for(h->capacity))
+        {
+            throw std::runtime_error("persistent_vector: corrupted header.");
+        }
+    }
+
+    // 中身はファイル上にそのまま残るので、要素のmoveは不要
+    // 新しいサイズでmapできてから古いmapと差し替える。失敗しても元のmapとファイルサイズのまま(強い保証)
+    void remap(size_type cap)
+    {
+        auto old_size = mapped_size;
+        auto new_size = file_size_for(cap);
+        if (new_size > old_size)
+        {
+            // ファイルの末尾より先をmapしても、触るとSIGBUSになるので先に伸ばす
+            truncate(new_size);
+        }
+        void *p;
+        try
+        {
+            p = map_file(new_size);
+        }
+        catch (...)
+        {
+            if (new_size > old_size)
+            {
+                // 元の大きさに戻す。戻せなくても、ファイルが余分に大きいだけでheaderとは矛盾しない
+                [[maybe_unused]] auto r = ::ftruncate(fd, static_cast<off_t>(old_size));
+            }
+            throw;
+        }
+        unmap();
+        mapped = p;
+        mapped_size = new_size;
+        head()->capacity = cap;
+        if (new_size < old_size)
+        {
+            // 縮める場合はmapし直してから切り詰める。失敗してもファイルが余分に大きいだけ
+            truncate(new_size);
+        }
+    }
+};
+
+int main(int argc, char **argv)
+{
+    struct point
+    {
+        int x;
+        int y;
+    };
+    const char *path = argc > 1 ? argv[1] : "persistent_vector.dat";
+
+    {
+        persistent_vector<point> v(path);
+        std::cout << "reopened size: " << v.size() << " capacity: " << v.capacity() << std::endl;
+        for (int i = 0; i != 10; ++i)
+        {
+            v.push_back(point{i, i * i});
+        }
+        v.sync();
+        std::cout << "size: " << v.size() << " back: " << v.back().x << ',' << v.back().y << std::endl;
+    }
+    // 2回目以降はファイルをmmapするだけで前回の要素が見える
+    {
+        persistent_vector<point> v(path);
+        std::cout << "reopened size: " << v.size() << std::endl;
+        std::for_each(v.begin(), v.end(), [](auto p)
+                      { std::cout << p.y << ' '; });
+        std::cout << std::endl;
+    }
+}
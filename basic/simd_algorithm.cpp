@@ -0,0 +1,657 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+// vectorやarrayの連続領域に対するSIMD版アルゴリズム
+// * カーネルはGCC/clangのベクトル拡張(vector_size)で幅(byte数)をテンプレート引数にして1つだけ書く
+// * それをtarget属性つきの関数(SSE2/AVX2/AVX-512)から呼び、実行時にCPUが対応している一番広いものを選ぶ
+//   カーネルはalways_inlineなので、呼び出し元のtarget属性の命令セットでコード生成される
+// * 対応する型はint, float, double
+// * 浮動小数点のsumは加算順序がスカラー版と異なるので、結果は丸め誤差の範囲で一致する
+// * min_element/max_elementはNaNを無視する。全てがNaNなら先頭を返す
+// * fmaは浮動小数点では1回だけ丸める(std::fmaと同じ結果)。SSE2にはFMA命令がないので、その場合はライブラリ関数になり遅い
+// ベクトルを受け渡すヘルパ(load/store)は全てalways_inlineで、target属性の異なる関数間で値渡しされることはないので
+// GCCの-Wpsabi(呼び出し規約が変わるという警告)は抑止しておく
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace simd
+{
+    enum class isa
+    {
+        sse2,
+        avx2,
+        avx512,
+    };
+
+    // 下のSIMD_AVX2/SIMD_AVX512のtarget属性に並べた拡張を全て持っている場合だけ、そのISAを使う
+    // (Knights LandingのようにAVX-512Fだけあって、BW/DQ/VLのないCPUもある)
+    inline isa detect() noexcept
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") &&
+            __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl") &&
+            __builtin_cpu_supports("fma"))
+        {
+            return isa::avx512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return isa::avx2;
+        }
+        // x86-64ではSSE2は必ずある
+        return isa::sse2;
+    }
+
+    // 起動時に1度だけ判定する。テスト用に書き換えられるよう参照を返す
+    inline isa &current_isa() noexcept
+    {
+        static isa value = detect();
+        return value;
+    }
+
+    namespace detail
+    {
+        template <typename T, std::size_t Bytes>
+        struct vec_impl
+        {
+            typedef T type __attribute__((vector_size(Bytes)));
+        };
+        template <typename T, std::size_t Bytes>
+        using vec = typename vec_impl<T, Bytes>::type;
+
+        // 比較結果のマスクの要素型(同じ幅の符号付き整数)
+        template <typename T>
+        using mask_elem = std::conditional_t<sizeof(T) == 4, int, long long>;
+
+        // intのsumはオーバーフローが未定義動作にならないようunsignedで回す
+        template <typename T>
+        struct acc_impl
+        {
+            using type = T;
+        };
+        template <>
+        struct acc_impl<int>
+        {
+            using type = unsigned;
+        };
+        template <typename T>
+        using acc_elem = typename acc_impl<T>::type;
+
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+        // アライメントを仮定しないロード・ストア(movdqu/vmovups等になる)
+        template <typename V, typename T>
+        SIMD_INLINE V load(const T *p) noexcept
+        {
+            V v;
+            __builtin_memcpy(&v, p, sizeof(V));
+            return v;
+        }
+        template <typename V, typename T>
+        SIMD_INLINE void store(T *p, const V &v) noexcept
+        {
+            __builtin_memcpy(p, &v, sizeof(V));
+        }
+        template <typename V, typename T>
+        SIMD_INLINE V splat(T x) noexcept
+        {
+            V v;
+            for (std::size_t i = 0; i != sizeof(V) / sizeof(T); ++i)
+            {
+                v[i] = x;
+            }
+            return v;
+        }
+
+        // 依存チェーンを切るために4本のアキュムレータで回す
+        template <std::size_t Bytes, typename T>
+        SIMD_INLINE T sum(const T *p, std::size_t n) noexcept
+        {
+            using A = acc_elem<T>;
+            using V = vec<A, Bytes>;
+            constexpr std::size_t W = Bytes / sizeof(T);
+            V a0 = {}, a1 = {}, a2 = {}, a3 = {};
+            std::size_t i = 0;
+            for (; i + 4 * W <= n; i += 4 * W)
+            {
+                a0 += load<V>(p + i);
+                a1 += load<V>(p + i + W);
+                a2 += load<V>(p + i + 2 * W);
+                a3 += load<V>(p + i + 3 * W);
+            }
+            for (; i + W <= n; i += W)
+            {
+                a0 += load<V>(p + i);
+            }
+            V acc = (a0 + a1) + (a2 + a3);
+            A r = 0;
+            for (std::size_t j = 0; j != W; ++j)
+            {
+                r += acc[j];
+            }
+            for (; i != n; ++i)
+            {
+                r += static_cast<A>(p[i]);
+            }
+            return static_cast<T>(r);
+        }
+
+        // Maxがfalseならmin、trueならmax
+        // rがNaNなら何とでも置き換える(NaNは無視する)。lがNaNなら比較がfalseになるので置き換えない
+        template <bool Max, typename T>
+        SIMD_INLINE bool better(T l, T r) noexcept
+        {
+            return (Max ? l > r : l < r) || r != r;
+        }
+
+        template <std::size_t Bytes, bool Max, typename T>
+        SIMD_INLINE const T *select(const T *p, std::size_t n) noexcept
+        {
+            using V = vec<T, Bytes>;
+            constexpr std::size_t W = Bytes / sizeof(T);
+            if (n == 0)
+            {
+                return p;
+            }
+            T r = p[0];
+            std::size_t i = 0;
+            if (n >= W)
+            {
+                V best = load<V>(p);
+                for (i = W; i + W <= n; i += W)
+                {
+                    V v = load<V>(p + i);
+                    // ベクトルを関数に渡すと呼び出し規約の警告が出るのでここで直接比較する
+                    // NaNのレーンは次に来た値で置き換える(整数では常にfalseなので消える)
+                    if constexpr (Max)
+                    {
+                        best = (v > best) | (best != best) ? v : best;
+                    }
+                    else
+                    {
+                        best = (v < best) | (best != best) ? v : best;
+                    }
+                }
+                r = best[0];
+                for (std::size_t j = 1; j != W; ++j)
+                {
+                    r = better<Max>(best[j], r) ? best[j] : r;
+                }
+            }
+            for (; i != n; ++i)
+            {
+                r = better<Max>(p[i], r) ? p[i] : r;
+            }
+            // 全てNaN
+            if (r != r)
+            {
+                return p;
+            }
+            // 値は決まったので、最初に現れる位置を返す
+            return std::find(p, p + n, r);
+        }
+
+        template <std::size_t Bytes, typename T>
+        SIMD_INLINE std::size_t find(const T *p, std::size_t n, T value) noexcept
+        {
+            using V = vec<T, Bytes>;
+            using M = vec<mask_elem<T>, Bytes>;
+            constexpr std::size_t W = Bytes / sizeof(T);
+            const V target = splat<V>(value);
+            std::size_t i = 0;
+            for (; i + W <= n; i += W)
+            {
+                M m = load<V>(p + i) == target;
+                // 1レーンでも一致したらそのブロック内をスカラーで探す
+                mask_elem<T> any = 0;
+                for (std::size_t j = 0; j != W; ++j)
+                {
+                    any |= m[j];
+                }
+                if (any)
+                {
+                    break;
+                }
+            }
+            for (; i != n; ++i)
+            {
+                if (p[i] == value)
+                {
+                    return i;
+                }
+            }
+            return n;
+        }
+
+        template <std::size_t Bytes, typename T>
+        SIMD_INLINE std::size_t count(const T *p, std::size_t n, T value) noexcept
+        {
+            using V = vec<T, Bytes>;
+            using M = vec<mask_elem<T>, Bytes>;
+            constexpr std::size_t W = Bytes / sizeof(T);
+            const V target = splat<V>(value);
+            // 一致したレーンは-1になるので引けば+1される
+            M acc = {};
+            std::size_t i = 0;
+            for (; i + W <= n; i += W)
+            {
+                acc -= (load<V>(p + i) == target);
+            }
+            std::size_t r = 0;
+            for (std::size_t j = 0; j != W; ++j)
+            {
+                r += static_cast<std::size_t>(acc[j]);
+            }
+            for (; i != n; ++i)
+            {
+                r += p[i] == value;
+            }
+            return r;
+        }
+
+        // fは要素ごとのスカラー関数。呼び出し元のtarget属性の関数内でインライン展開されてベクトル化される
+        // (ベクトル型のままfに渡すと、fがインライン展開されなかった場合にtarget属性の異なる関数間で
+        //  ベクトルを値渡しすることになり、呼び出し規約が食い違う)
+        template <std::size_t Bytes, typename T, typename F>
+        SIMD_INLINE void transform(const T *in, T *out, std::size_t n, F f)
+        {
+            using V = vec<T, Bytes>;
+            constexpr std::size_t W = Bytes / sizeof(T);
+            std::size_t i = 0;
+            for (; i + W <= n; i += W)
+            {
+                V x = load<V>(in + i);
+                V y;
+                for (std::size_t j = 0; j != W; ++j)
+                {
+                    y[j] = f(x[j]);
+                }
+                store(out + i, y);
+            }
+            for (; i != n; ++i)
+            {
+                out[i] = f(in[i]);
+            }
+        }
+
+        // out = a * b + c
+        // 浮動小数点ではa * b + cと書いても、-std=c++20では積と和を別々に丸める(-ffp-contract=off)
+        // レーンごとにstd::fmaを呼び、呼び出し元のtarget属性でFMA命令にさせる
+        template <std::size_t Bytes, typename T>
+        SIMD_INLINE void fma(const T *a, const T *b, const T *c, T *out, std::size_t n) noexcept
+        {
+            using V = vec<acc_elem<T>, Bytes>;
+            using U = acc_elem<T>;
+            constexpr std::size_t W = Bytes / sizeof(T);
+            std::size_t i = 0;
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                for (; i + W <= n; i += W)
+                {
+                    V x = load<V>(a + i), y = load<V>(b + i), z = load<V>(c + i);
+                    V r;
+                    for (std::size_t j = 0; j != W; ++j)
+                    {
+                        r[j] = std::fma(x[j], y[j], z[j]);
+                    }
+                    store(out + i, r);
+                }
+                for (; i != n; ++i)
+                {
+                    out[i] = std::fma(a[i], b[i], c[i]);
+                }
+            }
+            else
+            {
+                // 整数は丸めがないので、積と和を別々にしても同じ
+                for (; i + W <= n; i += W)
+                {
+                    store(out + i, load<V>(a + i) * load<V>(b + i) + load<V>(c + i));
+                }
+                for (; i != n; ++i)
+                {
+                    out[i] = static_cast<T>(static_cast<U>(a[i]) * static_cast<U>(b[i]) + static_cast<U>(c[i]));
+                }
+            }
+        }
+
+        // ISAごとの入口。AVX2はFMA命令も使えるようにしておく
+#define SIMD_SSE2 __attribute__((target("sse2")))
+#define SIMD_AVX2 __attribute__((target("avx2,fma")))
+#define SIMD_AVX512 __attribute__((target("avx512f,avx512dq,avx512bw,avx512vl,fma")))
+
+        template <typename T>
+        SIMD_SSE2 T sum_sse2(const T *p, std::size_t n) { return sum<16>(p, n); }
+        template <typename T>
+        SIMD_AVX2 T sum_avx2(const T *p, std::size_t n) { return sum<32>(p, n); }
+        template <typename T>
+        SIMD_AVX512 T sum_avx512(const T *p, std::size_t n) { return sum<64>(p, n); }
+
+        template <bool Max, typename T>
+        SIMD_SSE2 const T *select_sse2(const T *p, std::size_t n) { return select<16, Max>(p, n); }
+        template <bool Max, typename T>
+        SIMD_AVX2 const T *select_avx2(const T *p, std::size_t n) { return select<32, Max>(p, n); }
+        template <bool Max, typename T>
+        SIMD_AVX512 const T *select_avx512(const T *p, std::size_t n) { return select<64, Max>(p, n); }
+
+        template <typename T>
+        SIMD_SSE2 std::size_t find_sse2(const T *p, std::size_t n, T v) { return find<16>(p, n, v); }
+        template <typename T>
+        SIMD_AVX2 std::size_t find_avx2(const T *p, std::size_t n, T v) { return find<32>(p, n, v); }
+        template <typename T>
+        SIMD_AVX512 std::size_t find_avx512(const T *p, std::size_t n, T v) { return find<64>(p, n, v); }
+
+        template <typename T>
+        SIMD_SSE2 std::size_t count_sse2(const T *p, std::size_t n, T v) { return count<16>(p, n, v); }
+        template <typename T>
+        SIMD_AVX2 std::size_t count_avx2(const T *p, std::size_t n, T v) { return count<32>(p, n, v); }
+        template <typename T>
+        SIMD_AVX512 std::size_t count_avx512(const T *p, std::size_t n, T v) { return count<64>(p, n, v); }
+
+        template <typename T, typename F>
+        SIMD_SSE2 void transform_sse2(const T *in, T *out, std::size_t n, F f) { transform<16>(in, out, n, f); }
+        template <typename T, typename F>
+        SIMD_AVX2 void transform_avx2(const T *in, T *out, std::size_t n, F f) { transform<32>(in, out, n, f); }
+        template <typename T, typename F>
+        SIMD_AVX512 void transform_avx512(const T *in, T *out, std::size_t n, F f) { transform<64>(in, out, n, f); }
+
+        template <typename T>
+        SIMD_SSE2 void fma_sse2(const T *a, const T *b, const T *c, T *out, std::size_t n) { fma<16>(a, b, c, out, n); }
+        template <typename T>
+        SIMD_AVX2 void fma_avx2(const T *a, const T *b, const T *c, T *out, std::size_t n) { fma<32>(a, b, c, out, n); }
+        template <typename T>
+        SIMD_AVX512 void fma_avx512(const T *a, const T *b, const T *c, T *out, std::size_t n) { fma<64>(a, b, c, out, n); }
+
+#undef SIMD_SSE2
+#undef SIMD_AVX2
+#undef SIMD_AVX512
+#undef SIMD_INLINE
+
+        template <typename T>
+        constexpr bool supported = std::is_same_v<T, int> || std::is_same_v<T, float> || std::is_same_v<T, double>;
+    }
+
+    template <typename T>
+    T sum(const T *p, std::size_t n)
+    {
+        static_assert(detail::supported<T>);
+        switch (current_isa())
+        {
+        case isa::avx512:
+            return detail::sum_avx512(p, n);
+        case isa::avx2:
+            return detail::sum_avx2(p, n);
+        default:
+            return detail::sum_sse2(p, n);
+        }
+    }
+
+    // std::min_element/max_elementと同じく、最初に現れる最小(最大)要素へのポインタを返す
+    template <typename T>
+    const T *min_element(const T *p, std::size_t n)
+    {
+        static_assert(detail::supported<T>);
+        switch (current_isa())
+        {
+        case isa::avx512:
+            return detail::select_avx512<false>(p, n);
+        case isa::avx2:
+            return detail::select_avx2<false>(p, n);
+        default:
+            return detail::select_sse2<false>(p, n);
+        }
+    }
+    template <typename T>
+    const T *max_element(const T *p, std::size_t n)
+    {
+        static_assert(detail::supported<T>);
+        switch (current_isa())
+        {
+        case isa::avx512:
+            return detail::select_avx512<true>(p, n);
+        case isa::avx2:
+            return detail::select_avx2<true>(p, n);
+        default:
+            return detail::select_sse2<true>(p, n);
+        }
+    }
+
+    // 見つからなければnを返す
+    template <typename T>
+    std::size_t find(const T *p, std::size_t n, T value)
+    {
+        static_assert(detail::supported<T>);
+        switch (current_isa())
+        {
+        case isa::avx512:
+            return detail::find_avx512(p, n, value);
+        case isa::avx2:
+            return detail::find_avx2(p, n, value);
+        default:
+            return detail::find_sse2(p, n, value);
+        }
+    }
+
+    template <typename T>
+    std::size_t count(const T *p, std::size_t n, T value)
+    {
+        static_assert(detail::supported<T>);
+        switch (current_isa())
+        {
+        case isa::avx512:
+            return detail::count_avx512(p, n, value);
+        case isa::avx2:
+            return detail::count_avx2(p, n, value);
+        default:
+            return detail::count_sse2(p, n, value);
+        }
+    }
+
+    template <typename T, typename F>
+    void transform(const T *in, T *out, std::size_t n, F f)
+    {
+        static_assert(detail::supported<T>);
+        switch (current_isa())
+        {
+        case isa::avx512:
+            return detail::transform_avx512(in, out, n, f);
+        case isa::avx2:
+            return detail::transform_avx2(in, out, n, f);
+        default:
+            return detail::transform_sse2(in, out, n, f);
+        }
+    }
+
+    template <typename T>
+    void fma(const T *a, const T *b, const T *c, T *out, std::size_t n)
+    {
+        static_assert(detail::supported<T>);
+        switch (current_isa())
+        {
+        case isa::avx512:
+            return detail::fma_avx512(a, b, c, out, n);
+        case isa::avx2:
+            return detail::fma_avx2(a, b, c, out, n);
+        default:
+            return detail::fma_sse2(a, b, c, out, n);
+        }
+    }
+
+    // begin()/end()が連続領域を指すコンテナ(vector, array, std::vector等)向けの薄いラッパ
+    template <typename Container>
+    auto sum(const Container &c)
+    {
+        return sum(&*std::begin(c), static_cast<std::size_t>(std::end(c) - std::begin(c)));
+    }
+    template <typename Container, typename T>
+    std::size_t count(const Container &c, T value)
+    {
+        return count(&*std::begin(c), static_cast<std::size_t>(std::end(c) - std::begin(c)), value);
+    }
+}
+
+// 以下はスカラー版との突き合わせ
+// 端数処理を確認するために、幅で割り切れない長さも含めて試す
+namespace
+{
+    int failures = 0;
+
+    template <typename T>
+    void expect(bool ok, const char *what, std::size_t n)
+    {
+        if (!ok)
+        {
+            ++failures;
+            std::cout << "NG: " << what << " n=" << n << " type=" << typeid(T).name() << std::endl;
+        }
+    }
+
+    template <typename T>
+    bool near(T l, T r)
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            return l == r;
+        }
+        else
+        {
+            return std::abs(l - r) <= std::abs(r) * T(1e-4) + T(1e-4);
+        }
+    }
+
+    template <typename T>
+    void check(std::mt19937 &rng)
+    {
+        std::uniform_int_distribution<int> dist(-100, 100);
+        for (std::size_t n : {0, 1, 3, 7, 15, 16, 17, 31, 64, 100, 1000, 4099})
+        {
+            std::vector<T> a(n), b(n), c(n), out(n), ref(n);
+            for (std::size_t i = 0; i != n; ++i)
+            {
+                a[i] = static_cast<T>(dist(rng));
+                b[i] = static_cast<T>(dist(rng));
+                c[i] = static_cast<T>(dist(rng));
+            }
+            const T *p = a.data();
+
+            T s = 0;
+            for (auto x : a)
+            {
+                s += x;
+            }
+            expect<T>(near(simd::sum(p, n), s), "sum", n);
+            expect<T>(simd::min_element(p, n) == std::min_element(p, p + n), "min", n);
+            expect<T>(simd::max_element(p, n) == std::max_element(p, p + n), "max", n);
+
+            T needle = n ? a[n * 2 / 3] : T(0);
+            expect<T>(simd::find(p, n, needle) == static_cast<std::size_t>(std::find(p, p + n, needle) - p), "find", n);
+            expect<T>(simd::find(p, n, T(1000)) == n, "find(absent)", n);
+            expect<T>(simd::count(p, n, needle) == static_cast<std::size_t>(std::count(p, p + n, needle)), "count", n);
+
+            auto f = [](auto x)
+            { return x * 3 + 1; };
+            simd::transform(p, out.data(), n, f);
+            std::transform(p, p + n, ref.begin(), f);
+            expect<T>(out == ref, "transform", n);
+
+            simd::fma(p, b.data(), c.data(), out.data(), n);
+            for (std::size_t i = 0; i != n; ++i)
+            {
+                if constexpr (std::is_floating_point_v<T>)
+                {
+                    ref[i] = std::fma(a[i], b[i], c[i]);
+                }
+                else
+                {
+                    ref[i] = a[i] * b[i] + c[i];
+                }
+            }
+            expect<T>(out == ref, "fma", n);
+        }
+    }
+
+    // NaNは無視し、全てNaNなら先頭を返す。NaNの位置はベクトルの先頭・途中・端数の全てを試す
+    template <typename T>
+    void check_nan(std::mt19937 &rng)
+    {
+        const T nan = std::numeric_limits<T>::quiet_NaN();
+        std::uniform_int_distribution<int> dist(-100, 100);
+        for (std::size_t n : {1, 3, 16, 17, 100, 1000})
+        {
+            std::vector<T> a(n);
+            for (auto &x : a)
+            {
+                x = static_cast<T>(dist(rng));
+            }
+            for (std::size_t k : {std::size_t(0), n / 2, n - 1})
+            {
+                auto b = a;
+                b[k] = nan;
+                if (k + 1 < n)
+                {
+                    b[k + 1] = nan;
+                }
+                // NaNを除いた中での最初の最小(最大)要素
+                const T *lo = nullptr, *hi = nullptr;
+                for (auto &x : b)
+                {
+                    if (x == x)
+                    {
+                        lo = lo == nullptr || x < *lo ? &x : lo;
+                        hi = hi == nullptr || x > *hi ? &x : hi;
+                    }
+                }
+                const T *p = b.data();
+                expect<T>(simd::min_element(p, n) == (lo ? lo : p), "min(NaN)", n);
+                expect<T>(simd::max_element(p, n) == (hi ? hi : p), "max(NaN)", n);
+            }
+            std::vector<T> all(n, nan);
+            expect<T>(simd::min_element(all.data(), n) == all.data(), "min(all NaN)", n);
+            expect<T>(simd::max_element(all.data(), n) == all.data(), "max(all NaN)", n);
+        }
+
+        // 積を丸めるとa * b == 1になり、0になってしまう組
+        const T e = std::ldexp(T(1), -std::numeric_limits<T>::digits / 2 - 1);
+        std::vector<T> x(37, 1 + e), y(37, 1 - e), z(37, T(-1)), out(37);
+        simd::fma(x.data(), y.data(), z.data(), out.data(), x.size());
+        expect<T>(std::all_of(out.begin(), out.end(), [&](T r)
+                              { return r == -e * e; }),
+                  "fma(fused)", x.size());
+    }
+}
+
+int main()
+{
+    const char *names[] = {"sse2", "avx2", "avx512"};
+    std::mt19937 rng(42);
+    // 対応しているISAを全て試す
+    for (auto i : {simd::isa::sse2, simd::isa::avx2, simd::isa::avx512})
+    {
+        if (i > simd::detect())
+        {
+            std::cout << names[static_cast<int>(i)] << ": not supported, skipped" << std::endl;
+            continue;
+        }
+        simd::current_isa() = i;
+        check<int>(rng);
+        check<float>(rng);
+        check<double>(rng);
+        check_nan<float>(rng);
+        check_nan<double>(rng);
+        std::cout << names[static_cast<int>(i)] << ": checked" << std::endl;
+    }
+    simd::current_isa() = simd::detect();
+
+    std::vector<double> metrics(1 << 20, 0.5);
+    std::cout << "sum: " << simd::sum(metrics) << std::endl;
+    std::cout << (failures == 0 ? "all ok" : "failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -1,134 +1,153 @@
 #include <iostream>
+#include "smart_pointer.hpp"
 
-template <typename T>
-class unique_ptr
+int main()
 {
-    T *ptr = nullptr;
-
-public:
-    unique_ptr() {}
-    explicit unique_ptr(T *ptr) : ptr(ptr) {}
-    ~unique_ptr()
-    {
-        std::cout << "-------------(unique_ptr) destructor called-----------" << std::endl;
-        delete ptr;
-    }
-    unique_ptr(const unique_ptr &) = delete;
-    unique_ptr &operator=(const unique_ptr &) = delete;
-
-    unique_ptr(unique_ptr &&r) : ptr(r.ptr)
     {
-        r.ptr = nullptr;
+        unique_ptr<std::pair<int, int>> p;
+        {
+            auto q = make_unique<std::pair<int, int>>(2, 3);
+            p = std::move(q);
+        }
+        std::cout << p->first << ':' << p->second << std::endl;
     }
-    unique_ptr &operator=(unique_ptr &&r)
+    std::cout << "============================" << std::endl;
     {
-        delete ptr;
-        ptr = r.ptr;
-        r.ptr = nullptr;
-        return *this;
+        shared_ptr<std::pair<int, int>> sp = make_shared<std::pair<int, int>>(2, 3);
+        {
+            auto spq = sp;
+            spq->first *= 2;
+            spq->second *= 2;
+        }
+        std::cout << sp->first << ':' << sp->second << std::endl;
     }
-    T &operator*() noexcept { return *ptr; }
-    T *operator->() noexcept { return ptr; }
-    T *get() noexcept { return ptr; }
-};
-
-template <typename T, class... Args>
-unique_ptr<T>
-make_unique(Args &&...args)
-{
-    return unique_ptr<T>(new T(std::forward<Args>(args)...));
-}
-
-template <typename T>
-class shared_ptr
-{
-
-    T *ptr = nullptr;
-    std::size_t *count = nullptr;
-
-    void release()
+    std::cout << "============================" << std::endl;
     {
-        if (count == nullptr)
+        // 複数スレッドから同時にコピー・破棄しても参照カウントが壊れない
+        auto sp = make_shared<std::pair<int, int>>(1, 1);
+        std::vector<std::thread> threads;
+        for (int t = 0; t != 4; ++t)
         {
-            return;
+            threads.emplace_back([sp]
+                                 {
+                                     for (int i = 0; i != 100000; ++i)
+                                     {
+                                         auto copy = sp;
+                                     } });
         }
-        --*count;
-        if (*count == 0)
+        for (auto &t : threads)
         {
-            delete ptr;
-            ptr = nullptr;
-            delete count;
-            count = nullptr;
+            t.join();
         }
-    }
+        // 1
+        std::cout << sp.use_count() << std::endl;
 
-public:
-    shared_ptr() {}
-    explicit shared_ptr(T *ptr) : ptr(ptr), count(new std::size_t(1))
-    {
-    }
-    ~shared_ptr()
-    {
-        release();
-        std::cout << "-------------(shared_ptr) destructor called-----------" << std::endl;
-    }
-    shared_ptr(const shared_ptr &r) : ptr(r.ptr), count(r.count)
-    {
-        ++*count;
+        auto local = make_local_shared<std::string>("local");
+        auto local2 = local;
+        std::cout << *local2 << ' ' << local.use_count() << std::endl;
     }
-    shared_ptr &operator=(const shared_ptr &r)
+    std::cout << "============================" << std::endl;
     {
-        if (*this == &r)
-            return *this;
+        struct message : intrusive_ref_counter<message>
+        {
+            int id;
+            std::string body;
+            message(int id, std::string body) : id(id), body(std::move(body)) {}
+        };
+        // ポインタ1つ分の大きさ
+        static_assert(sizeof(intrusive_ptr<message>) == sizeof(message *));
 
-        release();
-        ptr = r.ptr;
-        count = r.count;
-        ++*count;
-    }
-    shared_ptr(shared_ptr &&r) : ptr(r.ptr), count(r.count)
-    {
-        r.ptr == nullptr;
-        r.count = nullptr;
+        auto m = make_intrusive<message>(1, "hello");
+        {
+            auto m2 = m;
+            m2->body += " world";
+            // 2
+            std::cout << m->use_count() << std::endl;
+        }
+        // 生ポインタからでも同じカウントを共有できる(shared_ptrではできない)
+        intrusive_ptr<message> m3(m.get());
+        std::cout << m3->id << ':' << m3->body << ' ' << m->use_count() << std::endl;
     }
-    shared_ptr &operator=(shared_ptr &&r)
+    std::cout << "============================" << std::endl;
     {
-        release();
-        ptr = r.ptr;
-        count = r.count;
-        r.ptr = nullptr;
-        r.count = nullptr;
-    }
-    T &operator*() noexcept { return *ptr; }
-    T *operator->() noexcept { return ptr; }
-    T *get() noexcept { return ptr; }
-};
+        // readerは常に一貫したスナップショットを読み、writerは途中で何度も差し替える
+        struct config
+        {
+            int version;
+            std::vector<int> routes;
+        };
+        static_assert(atomic_shared_ptr<config>::is_always_lock_free);
+        atomic_shared_ptr<config> current(make_shared<config>(0, std::vector<int>(8, 0)));
 
-template <typename T, class... Args>
-shared_ptr<T>
-make_shared(Args &&...args)
-{
-    return shared_ptr<T>(new T(std::forward<Args>(args)...));
-}
+        std::atomic<bool> stop{false};
+        std::atomic<long> reads{0};
+        std::vector<std::thread> readers;
+        for (int t = 0; t != 4; ++t)
+        {
+            readers.emplace_back([&]
+                                 {
+                                     while (!stop.load(std::memory_order_relaxed))
+                                     {
+                                         auto snapshot = current.load();
+                                         for (auto r : snapshot->routes)
+                                         {
+                                             if (r != snapshot->version)
+                                             {
+                                                 std::cout << "torn snapshot" << std::endl;
+                                             }
+                                         }
+                                         reads.fetch_add(1, std::memory_order_relaxed);
+                                     } });
+        }
+        for (int v = 1; v <= 10000; ++v)
+        {
+            current.store(make_shared<config>(v, std::vector<int>(8, v)));
+        }
+        // compare_exchange: 読んだ版が最新のままなら差し替える
+        auto expected = current.load();
+        auto next = make_shared<config>(expected->version + 1, std::vector<int>(8, expected->version + 1));
+        std::cout << current.compare_exchange_strong(expected, next) << ' ';
+        std::cout << current.compare_exchange_strong(expected, next) << ' ' << expected->version << std::endl;
 
-int main()
-{
-    {
-        unique_ptr<std::pair<int, int>> p;
+        stop = true;
+        for (auto &t : readers)
         {
-            auto q = make_unique<std::pair<int, int>>(2, 3);
-            p = std::move(q);
+            t.join();
         }
-        std::cout << p->first << ':' << p->second << std::endl;
+        // atomic_shared_ptr, expected, nextの3つ
+        auto last = current.load();
+        std::cout << last->version << ' ' << last.use_count() - 1 << ' ' << (reads > 0) << std::endl;
     }
     std::cout << "============================" << std::endl;
     {
-        shared_ptr<std::pair<int, int>> sp = make_shared<std::pair<int, int>>(2, 3);
+        // 大きなオブジェクトグラフの破棄を回収スレッドに任せる
+        static std::atomic<int> destroyed{0};
+        static std::thread::id destroyed_on;
+        struct graph
         {
-            auto spq = sp;
-            spq->first *= 2;
-            spq->second *= 2;
+            std::vector<std::string> nodes = std::vector<std::string>(100000, std::string(64, 'x'));
+            ~graph()
+            {
+                destroyed_on = std::this_thread::get_id();
+                destroyed.fetch_add(1);
+            }
+        };
+        {
+            unique_ptr<graph, deferred_delete<graph>> g(new graph);
+            shared_ptr<graph> sg(new graph, deferred_delete<graph>());
+            auto copy = sg;
         }
-        std::cout << sp->first << ':' << sp->second << std::endl;
+        // 手放した時点ではまだ破棄されていないかもしれない。flushで回収を待つ
+        deferred_reclaimer::instance().flush();
+        std::cout << destroyed << ' ' << (destroyed_on != std::this_thread::get_id()) << std::endl;
+
+        // limitを超えるとその場で破棄する
+        deferred_reclaimer small(1);
+        for (int i = 0; i != 100; ++i)
+        {
+            small.retire(new std::string(1000, 'y'));
+        }
+        small.flush();
+        std::cout << small.pending() << ' ' << (small.inline_count() > 0) << std::endl;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,742 @@
+#ifndef SMART_POINTER_HPP
+#define SMART_POINTER_HPP
+
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+template <typename T>
+struct default_delete
+{
+    void operator()(T *p) const noexcept
+    {
+        delete p;
+    }
+};
+
+// 破棄(デストラクタとdelete)をバックグラウンドの回収スレッドで行うためのもの
+// 大きなオブジェクトグラフの最後の参照を手放すと、そのスレッドでデストラクタが走り数msかかることがある
+// deferred_deleteをdeleterに指定すると、オブジェクトはここに積まれるだけで、破棄は回収スレッドが行う
+// * 積む側はリストの先頭にCASでつなぐだけ(lock-free)。回収スレッドはexchangeでリストごと取り出す
+//   1つずつ取り出すわけではないので、ABAもノードの解放タイミングの問題も起きない
+// * 回収が追いつかず、未回収の数がlimitに達したら、積まずにその場で破棄する(バックプレッシャー)
+//   メモリが際限なく増えない代わりに、その間は呼び出し側が破棄のコストを払う
+// * flush()は、呼び出し時点までに積まれたものが全て破棄されるまで待つ。回収スレッド上(破棄中のデストラクタ)からは呼ばないこと
+// * drain()は、積まれているものを呼び出したスレッドで破棄する
+class deferred_reclaimer
+{
+    struct node
+    {
+        node *next;
+        void *object;
+        void (*destroy)(void *) noexcept;
+    };
+
+    std::atomic<node *> head{nullptr};
+    std::atomic<std::uint64_t> retired{0};
+    std::atomic<std::uint64_t> destroyed{0};
+    std::atomic<std::uint64_t> inline_destroyed{0};
+    // 回収スレッドを起こすためのカウンタ。空のリストに積んだ時と停止時に増やす
+    std::atomic<std::uint32_t> wakeups{0};
+    std::atomic<bool> stop{false};
+    std::size_t limit;
+    std::thread worker;
+
+    void push(node *n) noexcept
+    {
+        retired.fetch_add(1, std::memory_order_relaxed);
+        auto old = head.load(std::memory_order_relaxed);
+        do
+        {
+            n->next = old;
+        } while (!head.compare_exchange_weak(old, n, std::memory_order_release, std::memory_order_relaxed));
+        // 空でなければ回収スレッドは起きているか、既に起こされている
+        if (old == nullptr)
+        {
+            wakeups.fetch_add(1, std::memory_order_release);
+            wakeups.notify_one();
+        }
+    }
+    // 取り出したリストは新しい順なので、逆順にして積まれた順に破棄する
+    std::size_t destroy_all(node *list) noexcept
+    {
+        node *fifo = nullptr;
+        while (list != nullptr)
+        {
+            auto next = list->next;
+            list->next = fifo;
+            fifo = list;
+            list = next;
+        }
+        std::size_t n = 0;
+        while (fifo != nullptr)
+        {
+            auto next = fifo->next;
+            fifo->destroy(fifo->object);
+            delete fifo;
+            fifo = next;
+            ++n;
+        }
+        return n;
+    }
+    std::size_t collect() noexcept
+    {
+        auto n = destroy_all(head.exchange(nullptr, std::memory_order_acquire));
+        if (n != 0)
+        {
+            destroyed.fetch_add(n, std::memory_order_release);
+            destroyed.notify_all();
+        }
+        return n;
+    }
+    void run() noexcept
+    {
+        while (true)
+        {
+            auto w = wakeups.load(std::memory_order_acquire);
+            if (collect() != 0)
+            {
+                continue;
+            }
+            // 停止後も、破棄中のデストラクタが積んだものがなくなるまで回収する
+            if (stop.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            // 最後の確認の後に積まれていればwakeupsが変わっているので、すぐに戻る
+            if (head.load(std::memory_order_acquire) == nullptr)
+            {
+                wakeups.wait(w, std::memory_order_acquire);
+            }
+        }
+    }
+
+public:
+    explicit deferred_reclaimer(std::size_t limit = 1 << 16) : limit(limit), worker([this]
+                                                                                   { run(); })
+    {
+    }
+    ~deferred_reclaimer()
+    {
+        stop.store(true, std::memory_order_release);
+        wakeups.fetch_add(1, std::memory_order_release);
+        wakeups.notify_one();
+        worker.join();
+    }
+    deferred_reclaimer(const deferred_reclaimer &) = delete;
+    deferred_reclaimer &operator=(const deferred_reclaimer &) = delete;
+
+    // deferred_deleteが使うプロセス全体で1つの回収スレッド
+    static deferred_reclaimer &instance()
+    {
+        static deferred_reclaimer reclaimer;
+        return reclaimer;
+    }
+
+    template <typename T>
+    void retire(T *p) noexcept
+    {
+        if (p == nullptr)
+        {
+            return;
+        }
+        node *n = nullptr;
+        if (pending() < limit)
+        {
+            n = new (std::nothrow) node{nullptr, p, [](void *q) noexcept
+                                        { delete static_cast<T *>(q); }};
+        }
+        if (n == nullptr)
+        {
+            inline_destroyed.fetch_add(1, std::memory_order_relaxed);
+            delete p;
+            return;
+        }
+        push(n);
+    }
+    void flush() noexcept
+    {
+        auto target = retired.load(std::memory_order_acquire);
+        auto done = destroyed.load(std::memory_order_acquire);
+        while (done < target)
+        {
+            destroyed.wait(done, std::memory_order_acquire);
+            done = destroyed.load(std::memory_order_acquire);
+        }
+    }
+    void drain() noexcept
+    {
+        while (collect() != 0)
+        {
+        }
+    }
+    // 積まれてまだ破棄されていない数
+    std::size_t pending() const noexcept
+    {
+        return retired.load(std::memory_order_relaxed) - destroyed.load(std::memory_order_relaxed);
+    }
+    // バックプレッシャーでその場で破棄した数
+    std::uint64_t inline_count() const noexcept
+    {
+        return inline_destroyed.load(std::memory_order_relaxed);
+    }
+};
+
+// unique_ptr<T, deferred_delete<T>>やshared_ptr<T>(p, deferred_delete<T>{})のように使う
+template <typename T>
+struct deferred_delete
+{
+    void operator()(T *p) const noexcept
+    {
+        deferred_reclaimer::instance().retire(p);
+    }
+};
+
+template <typename T, typename Deleter = default_delete<T>>
+class unique_ptr
+{
+    T *ptr = nullptr;
+    [[no_unique_address]] Deleter deleter;
+
+public:
+    unique_ptr() {}
+    explicit unique_ptr(T *ptr, Deleter deleter = Deleter()) : ptr(ptr), deleter(std::move(deleter)) {}
+    ~unique_ptr()
+    {
+        if (ptr != nullptr)
+        {
+            deleter(ptr);
+        }
+    }
+    unique_ptr(const unique_ptr &) = delete;
+    unique_ptr &operator=(const unique_ptr &) = delete;
+
+    unique_ptr(unique_ptr &&r) : ptr(r.ptr), deleter(std::move(r.deleter))
+    {
+        r.ptr = nullptr;
+    }
+    unique_ptr &operator=(unique_ptr &&r)
+    {
+        if (this == &r)
+            return *this;
+
+        reset(r.ptr);
+        r.ptr = nullptr;
+        deleter = std::move(r.deleter);
+        return *this;
+    }
+    void reset(T *p = nullptr)
+    {
+        auto old = ptr;
+        ptr = p;
+        if (old != nullptr)
+        {
+            deleter(old);
+        }
+    }
+    T &operator*() noexcept { return *ptr; }
+    T *operator->() noexcept { return ptr; }
+    T *get() noexcept { return ptr; }
+    Deleter &get_deleter() noexcept { return deleter; }
+};
+
+template <typename T, class... Args>
+unique_ptr<T>
+make_unique(Args &&...args)
+{
+    return unique_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+// 参照カウントの増減の方法(ポリシー)
+// 複数スレッドから同じオブジェクトを共有する場合はatomic_count、1スレッドに閉じている場合はsingle_thread_countを使う
+// single_thread_countはatomic命令(lock xadd等)を使わないので、競合がない場合でもその分速い
+struct atomic_count
+{
+    using count_type = std::atomic<std::size_t>;
+
+    // 増やす側は既に参照を持っているので、他のメモリ操作との順序は不要(relaxed)
+    static void increment(count_type &count) noexcept
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+    // 最後の1つになった時だけtrue
+    // 他のスレッドが手放す前に行ったオブジェクトへの書き込みを、破棄するスレッドから見えるようにする必要がある
+    // そのため減らす側はrelease、0になったスレッドはacquireのfenceを置いてから破棄する
+    static bool decrement(count_type &count) noexcept
+    {
+        if (count.fetch_sub(1, std::memory_order_release) == 1)
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+    static std::size_t load(const count_type &count) noexcept
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+};
+
+struct single_thread_count
+{
+    using count_type = std::size_t;
+
+    static void increment(count_type &count) noexcept
+    {
+        ++count;
+    }
+    static bool decrement(count_type &count) noexcept
+    {
+        return --count == 0;
+    }
+    static std::size_t load(const count_type &count) noexcept
+    {
+        return count;
+    }
+};
+
+// 参照カウントとオブジェクトの破棄方法をまとめたもの(control block)
+// 最後の参照がなくなったらcontrol blockをdeleteし、派生クラスのデストラクタがオブジェクトを破棄する
+template <typename Policy>
+struct control_block
+{
+    typename Policy::count_type count{1};
+    // 管理しているオブジェクト。atomic_shared_ptrはcontrol blockだけを持つので、ここからT*を復元する
+    void *object = nullptr;
+
+    virtual ~control_block() = default;
+};
+
+// shared_ptr<T>(new T)の場合。オブジェクトとcontrol blockは別々に確保されている
+template <typename T, typename Policy, typename Deleter = default_delete<T>>
+struct pointer_control_block : control_block<Policy>
+{
+    T *ptr;
+    [[no_unique_address]] Deleter deleter;
+
+    pointer_control_block(T *ptr, Deleter deleter) : ptr(ptr), deleter(std::move(deleter))
+    {
+        this->object = ptr;
+    }
+    ~pointer_control_block() override
+    {
+        deleter(ptr);
+    }
+};
+
+// make_sharedの場合。オブジェクトをcontrol blockの中に置き、確保を1回で済ませる
+template <typename T, typename Policy>
+struct inplace_control_block : control_block<Policy>
+{
+    T value;
+
+    template <class... Args>
+    explicit inplace_control_block(Args &&...args) : value(std::forward<Args>(args)...)
+    {
+        this->object = &value;
+    }
+};
+
+template <typename T, typename Policy = atomic_count>
+class shared_ptr
+{
+    T *ptr = nullptr;
+    control_block<Policy> *block = nullptr;
+
+    template <typename U, typename P, class... Args>
+    friend shared_ptr<U, P> make_shared(Args &&...args);
+    template <typename U>
+    friend class atomic_shared_ptr;
+
+    shared_ptr(T *ptr, control_block<Policy> *block) noexcept : ptr(ptr), block(block) {}
+
+    void release() noexcept
+    {
+        if (block != nullptr && Policy::decrement(block->count))
+        {
+            delete block;
+        }
+        ptr = nullptr;
+        block = nullptr;
+    }
+
+public:
+    shared_ptr() {}
+    explicit shared_ptr(T *ptr) : shared_ptr(ptr, default_delete<T>()) {}
+    // 最後の参照がなくなった時にdeleter(ptr)を呼ぶ
+    // make_sharedで作った場合はオブジェクトがcontrol blockの中にあるので、deleterは指定できない
+    template <typename Deleter>
+        requires std::invocable<Deleter &, T *>
+    shared_ptr(T *ptr, Deleter deleter) : ptr(ptr)
+    {
+        // control blockの確保に失敗したらptrはリークさせずに破棄する
+        try
+        {
+            block = new pointer_control_block<T, Policy, Deleter>(ptr, deleter);
+        }
+        catch (...)
+        {
+            deleter(ptr);
+            throw;
+        }
+    }
+    ~shared_ptr()
+    {
+        release();
+    }
+    shared_ptr(const shared_ptr &r) noexcept : ptr(r.ptr), block(r.block)
+    {
+        if (block != nullptr)
+        {
+            Policy::increment(block->count);
+        }
+    }
+    shared_ptr &operator=(const shared_ptr &r) noexcept
+    {
+        if (this == &r)
+            return *this;
+
+        // 先に増やしておけば、rが自分と同じオブジェクトを指していても先に破棄されることはない
+        if (r.block != nullptr)
+        {
+            Policy::increment(r.block->count);
+        }
+        release();
+        ptr = r.ptr;
+        block = r.block;
+        return *this;
+    }
+    shared_ptr(shared_ptr &&r) noexcept : ptr(r.ptr), block(r.block)
+    {
+        r.ptr = nullptr;
+        r.block = nullptr;
+    }
+    shared_ptr &operator=(shared_ptr &&r) noexcept
+    {
+        if (this == &r)
+            return *this;
+
+        release();
+        ptr = r.ptr;
+        block = r.block;
+        r.ptr = nullptr;
+        r.block = nullptr;
+        return *this;
+    }
+    void reset() noexcept
+    {
+        release();
+    }
+    void swap(shared_ptr &r) noexcept
+    {
+        std::swap(ptr, r.ptr);
+        std::swap(block, r.block);
+    }
+    std::size_t use_count() const noexcept
+    {
+        return block == nullptr ? 0 : Policy::load(block->count);
+    }
+    T &operator*() const noexcept { return *ptr; }
+    T *operator->() const noexcept { return ptr; }
+    T *get() const noexcept { return ptr; }
+    explicit operator bool() const noexcept { return ptr != nullptr; }
+};
+
+// 1スレッドに閉じて使うshared_ptr
+template <typename T>
+using local_shared_ptr = shared_ptr<T, single_thread_count>;
+
+// オブジェクトとcontrol blockを1回のnewで確保する
+template <typename T, typename Policy = atomic_count, class... Args>
+shared_ptr<T, Policy>
+make_shared(Args &&...args)
+{
+    auto block = new inplace_control_block<T, Policy>(std::forward<Args>(args)...);
+    return shared_ptr<T, Policy>(&block->value, block);
+}
+
+template <typename T, class... Args>
+local_shared_ptr<T>
+make_local_shared(Args &&...args)
+{
+    return make_shared<T, single_thread_count>(std::forward<Args>(args)...);
+}
+
+// 複数スレッドから同時にload/storeできるshared_ptr(split reference count)
+// 設定やルーティングテーブルのスナップショットのように、多数のreaderが読み、writerがたまに差し替える用途向け
+// mutexで守ると全てのreaderが同じロックを取り合うが、こちらはreaderもwriterもブロックしない
+// * control blockへのポインタ(下位48bit)と、読み出し中のreaderの数(local count, 上位16bit)を1つの64bitに詰めて持つ
+// * readerはまずこの64bitのlocal countを1増やす。これでポインタと参照の取得が1命令でアトミックに行える
+//   その後control blockの参照カウント(global count)を増やし、local countを1減らして返す
+// * writerが差し替えた時点で残っていたlocal countは、古いcontrol blockのglobal countへ移す
+//   local countを返しに行ったreaderは、ポインタが変わっていればglobal countの方から1減らす
+// local countは16bitなので、同時にloadの途中にいられるreaderは65535まで
+template <typename T>
+class atomic_shared_ptr
+{
+    using block_type = control_block<atomic_count>;
+    static_assert(sizeof(void *) == 8, "atomic_shared_ptr packs a 48-bit pointer and a 16-bit count");
+
+    static constexpr int pointer_bits = 48;
+    static constexpr std::uintptr_t pointer_mask = (std::uintptr_t(1) << pointer_bits) - 1;
+    static constexpr std::uintptr_t local_one = std::uintptr_t(1) << pointer_bits;
+
+    // loadもlocal countを書き換えるのでmutable
+    mutable std::atomic<std::uintptr_t> word{0};
+
+    static block_type *block_of(std::uintptr_t w) noexcept
+    {
+        return reinterpret_cast<block_type *>(w & pointer_mask);
+    }
+    static std::size_t local_of(std::uintptr_t w) noexcept
+    {
+        return w >> pointer_bits;
+    }
+    // desiredの参照をそのまま引き取る
+    static std::uintptr_t take(shared_ptr<T> &desired) noexcept
+    {
+        auto w = reinterpret_cast<std::uintptr_t>(desired.block);
+        desired.ptr = nullptr;
+        desired.block = nullptr;
+        return w;
+    }
+    static shared_ptr<T> adopt(block_type *block) noexcept
+    {
+        return block == nullptr ? shared_ptr<T>() : shared_ptr<T>(static_cast<T *>(block->object), block);
+    }
+    // 外されたポインタに残っていたlocal countを、global countへ移す
+    static void transfer(std::uintptr_t old) noexcept
+    {
+        if (auto block = block_of(old); block != nullptr && local_of(old) != 0)
+        {
+            block->count.fetch_add(local_of(old), std::memory_order_relaxed);
+        }
+    }
+
+public:
+    static constexpr bool is_always_lock_free = std::atomic<std::uintptr_t>::is_always_lock_free;
+
+    atomic_shared_ptr() noexcept {}
+    explicit atomic_shared_ptr(shared_ptr<T> desired) noexcept : word(take(desired)) {}
+    ~atomic_shared_ptr()
+    {
+        // 破棄する時点でloadの途中のreaderはいないので、local countは0
+        adopt(block_of(word.load(std::memory_order_acquire)));
+    }
+    atomic_shared_ptr(const atomic_shared_ptr &) = delete;
+    atomic_shared_ptr &operator=(const atomic_shared_ptr &) = delete;
+
+    shared_ptr<T> load() const noexcept
+    {
+        // nullなら参照を取る必要はない
+        if (word.load(std::memory_order_relaxed) == 0)
+        {
+            return {};
+        }
+        // writerのstore(release)と対になるacquire。オブジェクトの中身が見えるようにする
+        auto w = word.fetch_add(local_one, std::memory_order_acquire);
+        auto block = block_of(w);
+        if (block != nullptr)
+        {
+            atomic_count::increment(block->count);
+        }
+        // local countを返す。ポインタが同じでlocal countが残っていればそこから減らす
+        // (差し替えられた後に同じポインタが戻ってきた場合でも、local countとglobal countの合計は変わらない)
+        // ポインタが変わっていれば、writerがlocal countをglobal countへ移しているので、そちらから減らす
+        auto expected = w + local_one;
+        while (true)
+        {
+            if (block_of(expected) != block || local_of(expected) == 0)
+            {
+                // 上でincrementしたので0にはならない
+                if (block != nullptr)
+                {
+                    atomic_count::decrement(block->count);
+                }
+                break;
+            }
+            if (word.compare_exchange_weak(expected, expected - local_one, std::memory_order_release, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        return adopt(block);
+    }
+    void store(shared_ptr<T> desired) noexcept
+    {
+        exchange(std::move(desired));
+    }
+    shared_ptr<T> exchange(shared_ptr<T> desired) noexcept
+    {
+        auto old = word.exchange(take(desired), std::memory_order_acq_rel);
+        transfer(old);
+        // atomic_shared_ptrが持っていた参照は、戻り値がそのまま引き継ぐ
+        return adopt(block_of(old));
+    }
+    // expectedと同じオブジェクトを指していればdesiredに差し替える
+    // 失敗した場合は、その時点の値をexpectedに読み込む
+    bool compare_exchange_strong(shared_ptr<T> &expected, shared_ptr<T> desired) noexcept
+    {
+        auto target = reinterpret_cast<std::uintptr_t>(desired.block);
+        auto cur = word.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if (block_of(cur) != expected.block)
+            {
+                auto now = load();
+                // 読み直している間に元に戻っていたらやり直す(strongなので見かけ上の失敗はしない)
+                if (now.block == expected.block)
+                {
+                    cur = word.load(std::memory_order_relaxed);
+                    continue;
+                }
+                expected = std::move(now);
+                return false;
+            }
+            // local countが変わっただけなら再試行する
+            if (word.compare_exchange_weak(cur, target, std::memory_order_acq_rel, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        take(desired);
+        transfer(cur);
+        // atomic_shared_ptrが持っていた参照を手放す。expectedも参照を持っているので0にはならない
+        if (auto block = block_of(cur); block != nullptr)
+        {
+            atomic_count::decrement(block->count);
+        }
+        return true;
+    }
+    bool compare_exchange_weak(shared_ptr<T> &expected, shared_ptr<T> desired) noexcept
+    {
+        return compare_exchange_strong(expected, std::move(desired));
+    }
+    operator shared_ptr<T>() const noexcept
+    {
+        return load();
+    }
+    atomic_shared_ptr &operator=(shared_ptr<T> desired) noexcept
+    {
+        store(std::move(desired));
+        return *this;
+    }
+};
+
+// 参照カウントをオブジェクト自身に埋め込むintrusive_ptr
+// shared_ptrはcontrol blockへのポインタも持つので2ポインタ分の大きさがあり、new Tで作ると確保も2回になる
+// intrusive_ptrはオブジェクトへのポインタ1つだけで、control blockもない
+// 参照カウントの増減は、ADLで見つかる次の2つの関数で行う(boost::intrusive_ptrと同じ規約)
+//   void intrusive_ptr_add_ref(T *p);
+//   void intrusive_ptr_release(T *p); // 0になったら破棄する
+// 自前で用意してもよいし、intrusive_ref_counterを継承すればそれが定義される
+template <typename T>
+class intrusive_ptr
+{
+    T *ptr = nullptr;
+
+public:
+    intrusive_ptr() {}
+    // add_refがfalseなら、既に持っている参照を引き取る(カウントを増やさない)
+    explicit intrusive_ptr(T *ptr, bool add_ref = true) : ptr(ptr)
+    {
+        if (ptr != nullptr && add_ref)
+        {
+            intrusive_ptr_add_ref(ptr);
+        }
+    }
+    ~intrusive_ptr()
+    {
+        if (ptr != nullptr)
+        {
+            intrusive_ptr_release(ptr);
+        }
+    }
+    intrusive_ptr(const intrusive_ptr &r) : intrusive_ptr(r.ptr) {}
+    intrusive_ptr &operator=(const intrusive_ptr &r)
+    {
+        // コピーしてから交換すれば、自己代入でも先に0になることはない
+        intrusive_ptr(r).swap(*this);
+        return *this;
+    }
+    intrusive_ptr(intrusive_ptr &&r) noexcept : ptr(r.ptr)
+    {
+        r.ptr = nullptr;
+    }
+    intrusive_ptr &operator=(intrusive_ptr &&r) noexcept
+    {
+        intrusive_ptr(std::move(r)).swap(*this);
+        return *this;
+    }
+    void reset() noexcept
+    {
+        intrusive_ptr().swap(*this);
+    }
+    void swap(intrusive_ptr &r) noexcept
+    {
+        std::swap(ptr, r.ptr);
+    }
+    // 参照を手放さずにポインタだけを取り出す。intrusive_ptr(p, false)で戻せる
+    T *detach() noexcept
+    {
+        auto p = ptr;
+        ptr = nullptr;
+        return p;
+    }
+    T &operator*() const noexcept { return *ptr; }
+    T *operator->() const noexcept { return ptr; }
+    T *get() const noexcept { return ptr; }
+    explicit operator bool() const noexcept { return ptr != nullptr; }
+};
+
+template <typename T, class... Args>
+intrusive_ptr<T>
+make_intrusive(Args &&...args)
+{
+    return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+// CRTPで参照カウントを埋め込むための基底クラス
+//   struct message : intrusive_ref_counter<message> { ... };
+// Policyはshared_ptrと同じ(atomic_countまたはsingle_thread_count)
+// Derivedのポインタでdeleteするので、仮想デストラクタは不要
+template <typename Derived, typename Policy = atomic_count>
+class intrusive_ref_counter
+{
+    mutable typename Policy::count_type count{0};
+
+    friend void intrusive_ptr_add_ref(const Derived *p) noexcept
+    {
+        Policy::increment(static_cast<const intrusive_ref_counter *>(p)->count);
+    }
+    friend void intrusive_ptr_release(const Derived *p) noexcept
+    {
+        if (Policy::decrement(static_cast<const intrusive_ref_counter *>(p)->count))
+        {
+            delete p;
+        }
+    }
+
+public:
+    std::size_t use_count() const noexcept
+    {
+        return Policy::load(count);
+    }
+
+protected:
+    intrusive_ref_counter() = default;
+    // コピーされたオブジェクトは新しいオブジェクトなので、カウントは引き継がない
+    intrusive_ref_counter(const intrusive_ref_counter &) noexcept {}
+    intrusive_ref_counter &operator=(const intrusive_ref_counter &) noexcept
+    {
+        return *this;
+    }
+    ~intrusive_ref_counter() = default;
+};
+
+#endif
@@ -0,0 +1,514 @@
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+// structure of arrays版のvector
+// vector<person>のように構造体をそのまま並べると(array of structs)、idだけを走査したい場合でも
+// nameがキャッシュラインに乗ってきてしまう。soa_vector<int, std::string>はフィールドごとに別の連続領域(カラム)を持つ
+// * 1行は各カラムの要素への参照をまとめたproxy(row)で表す
+// * column<I>()でカラムをstd::spanとして取り出せるので、そのままSIMDや標準アルゴリズムに渡せる
+template <typename... Fields>
+class soa_vector
+{
+    static_assert(sizeof...(Fields) > 0);
+
+public:
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::tuple<Fields...>;
+
+    template <std::size_t I>
+    using field_type = std::tuple_element_t<I, value_type>;
+
+    // 1行分の参照。get<I>()で各フィールドにアクセスする
+    template <bool Const>
+    struct basic_row
+    {
+        std::tuple<std::conditional_t<Const, const Fields &, Fields &>...> refs;
+
+        template <std::size_t I>
+        decltype(auto) get() const noexcept
+        {
+            return std::get<I>(refs);
+        }
+        // 値としてコピーを取り出す
+        operator value_type() const
+        {
+            return std::apply([](auto &...f)
+                              { return value_type(f...); },
+                              refs);
+        }
+    };
+    using reference = basic_row<false>;
+    using const_reference = basic_row<true>;
+
+    // ランダムアクセスイテレータ。参照はproxyなのでoperator*は値(row)を返す
+    template <bool Const>
+    class basic_iterator
+    {
+        using owner = std::conditional_t<Const, const soa_vector, soa_vector>;
+        owner *v = nullptr;
+        size_type i = 0;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = soa_vector::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = basic_row<Const>;
+        using pointer = void;
+
+        basic_iterator() = default;
+        basic_iterator(owner *v, size_type i) : v(v), i(i) {}
+        // iteratorからconst_iteratorへの変換
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        basic_iterator(const basic_iterator<false> &r) : v(r.v), i(r.i)
+        {
+        }
+
+        reference operator*() const { return (*v)[i]; }
+        reference operator[](difference_type n) const { return (*v)[i + n]; }
+
+        basic_iterator &operator++()
+        {
+            ++i;
+            return *this;
+        }
+        basic_iterator &operator--()
+        {
+            --i;
+            return *this;
+        }
+        basic_iterator operator++(int)
+        {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+        basic_iterator operator--(int)
+        {
+            auto copy = *this;
+            --*this;
+            return copy;
+        }
+        basic_iterator &operator+=(difference_type n)
+        {
+            i += n;
+            return *this;
+        }
+        basic_iterator &operator-=(difference_type n)
+        {
+            i -= n;
+            return *this;
+        }
+        friend basic_iterator operator+(basic_iterator it, difference_type n) { return it += n; }
+        friend basic_iterator operator+(difference_type n, basic_iterator it) { return it += n; }
+        friend basic_iterator operator-(basic_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const basic_iterator &l, const basic_iterator &r)
+        {
+            return static_cast<difference_type>(l.i) - static_cast<difference_type>(r.i);
+        }
+        friend bool operator==(const basic_iterator &l, const basic_iterator &r) { return l.i == r.i; }
+        friend auto operator<=>(const basic_iterator &l, const basic_iterator &r) { return l.i <=> r.i; }
+
+        friend class basic_iterator<!Const>;
+    };
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    soa_vector() = default;
+    ~soa_vector()
+    {
+        clear();
+        deallocate(columns, reserved);
+    }
+
+    soa_vector(const soa_vector &r)
+    {
+        reserve(r.size());
+        for (auto row : r)
+        {
+            push_back(row);
+        }
+    }
+    soa_vector &operator=(const soa_vector &r)
+    {
+        if (this == &r)
+        {
+            return *this;
+        }
+        clear();
+        reserve(r.size());
+        for (auto row : r)
+        {
+            push_back(row);
+        }
+        return *this;
+    }
+    soa_vector(soa_vector &&r) noexcept : columns(r.columns), count(r.count), reserved(r.reserved)
+    {
+        r.columns = {};
+        r.count = 0;
+        r.reserved = 0;
+    }
+    soa_vector &operator=(soa_vector &&r) noexcept
+    {
+        clear();
+        deallocate(columns, reserved);
+        columns = r.columns;
+        count = r.count;
+        reserved = r.reserved;
+        r.columns = {};
+        r.count = 0;
+        r.reserved = 0;
+        return *this;
+    }
+
+    // 各フィールドを1つずつ受け取る
+    // 引数はこのコンテナの要素を指していてもよい(v.push_back(v[0])など)
+    // 伸ばす場合は、新しい領域に新しい要素を構築してから既存の要素を移すので、移す前の要素を読む
+    template <typename... Args>
+    reference emplace_back(Args &&...args)
+    {
+        static_assert(sizeof...(Args) == sizeof...(Fields), "emplace_back takes one argument per field");
+        if (count == reserved)
+        {
+            auto sz = reserved == 0 ? 1 : reserved * 2;
+            auto fresh = allocate(sz);
+            try
+            {
+                construct_row(std::index_sequence_for<Fields...>{}, fresh, count, std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                deallocate(fresh, sz);
+                throw;
+            }
+            try
+            {
+                relocate(std::index_sequence_for<Fields...>{}, fresh);
+            }
+            catch (...)
+            {
+                destroy_row(std::index_sequence_for<Fields...>{}, fresh, count);
+                deallocate(fresh, sz);
+                throw;
+            }
+            replace_columns(fresh, sz);
+        }
+        else
+        {
+            construct_row(std::index_sequence_for<Fields...>{}, columns, count, std::forward<Args>(args)...);
+        }
+        ++count;
+        return back();
+    }
+    void push_back(const value_type &value)
+    {
+        std::apply([this](const auto &...f)
+                   { emplace_back(f...); },
+                   value);
+    }
+    void push_back(value_type &&value)
+    {
+        std::apply([this](auto &...f)
+                   { emplace_back(std::move(f)...); },
+                   value);
+    }
+    template <bool Const>
+    void push_back(const basic_row<Const> &row)
+    {
+        std::apply([this](const auto &...f)
+                   { emplace_back(f...); },
+                   row.refs);
+    }
+    void pop_back()
+    {
+        --count;
+        destroy_row(std::index_sequence_for<Fields...>{}, columns, count);
+    }
+
+    reference operator[](size_type i) noexcept
+    {
+        return row_at(std::index_sequence_for<Fields...>{}, i);
+    }
+    const_reference operator[](size_type i) const noexcept
+    {
+        return row_at(std::index_sequence_for<Fields...>{}, i);
+    }
+    reference at(size_type i)
+    {
+        if (i >= size())
+        {
+            throw std::out_of_range("index is out of range.");
+        }
+        return (*this)[i];
+    }
+    const_reference at(size_type i) const
+    {
+        if (i >= size())
+        {
+            throw std::out_of_range("index is out of range.");
+        }
+        return (*this)[i];
+    }
+    reference front() { return (*this)[0]; }
+    const_reference front() const { return (*this)[0]; }
+    reference back() { return (*this)[count - 1]; }
+    const_reference back() const { return (*this)[count - 1]; }
+
+    // I番目のフィールドのカラム
+    template <std::size_t I>
+    std::span<field_type<I>> column() noexcept
+    {
+        return {std::get<I>(columns), count};
+    }
+    template <std::size_t I>
+    std::span<const field_type<I>> column() const noexcept
+    {
+        return {std::get<I>(columns), count};
+    }
+
+    iterator begin() noexcept { return {this, 0}; }
+    iterator end() noexcept { return {this, count}; }
+    const_iterator begin() const noexcept { return {this, 0}; }
+    const_iterator end() const noexcept { return {this, count}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    size_type size() const noexcept { return count; }
+    size_type capacity() const noexcept { return reserved; }
+    bool empty() const noexcept { return count == 0; }
+
+    void reserve(size_type sz)
+    {
+        if (sz <= reserved)
+        {
+            return;
+        }
+        auto fresh = allocate(sz);
+        try
+        {
+            relocate(std::index_sequence_for<Fields...>{}, fresh);
+        }
+        catch (...)
+        {
+            deallocate(fresh, sz);
+            throw;
+        }
+        replace_columns(fresh, sz);
+    }
+    void clear() noexcept
+    {
+        clear_columns(columns, count);
+        count = 0;
+    }
+
+private:
+    std::tuple<Fields *...> columns{};
+    size_type count = 0;
+    size_type reserved = 0;
+
+    template <typename T>
+    using traits = std::allocator_traits<std::allocator<T>>;
+
+    static std::tuple<Fields *...> allocate(size_type n)
+    {
+        std::tuple<Fields *...> r{};
+        try
+        {
+            std::apply([n](auto &...col)
+                       { ((col = allocate_column<std::remove_pointer_t<std::remove_reference_t<decltype(col)>>>(n)), ...); },
+                       r);
+        }
+        catch (...)
+        {
+            deallocate(r, n);
+            throw;
+        }
+        return r;
+    }
+    template <typename T>
+    static T *allocate_column(size_type n)
+    {
+        std::allocator<T> alloc;
+        return traits<T>::allocate(alloc, n);
+    }
+    static void deallocate(std::tuple<Fields *...> &cols, size_type n) noexcept
+    {
+        std::apply([n](auto &...col)
+                   { (deallocate_column(col, n), ...); },
+                   cols);
+        cols = {};
+    }
+    template <typename T>
+    static void deallocate_column(T *col, size_type n) noexcept
+    {
+        if (col != nullptr)
+        {
+            std::allocator<T> alloc;
+            traits<T>::deallocate(alloc, col, n);
+        }
+    }
+    // vectorと同じく末尾から破棄する
+    static void clear_columns(std::tuple<Fields *...> &cols, size_type n) noexcept
+    {
+        std::apply([n](auto &...col)
+                   { (std::destroy(std::make_reverse_iterator(col + n), std::make_reverse_iterator(col)), ...); },
+                   cols);
+    }
+
+    // 要素を移し終えた新しいカラムに差し替える
+    void replace_columns(std::tuple<Fields *...> &fresh, size_type sz) noexcept
+    {
+        clear_columns(columns, count);
+        deallocate(columns, reserved);
+        columns = fresh;
+        reserved = sz;
+    }
+
+    template <std::size_t... I, typename... Args>
+    static void construct_row(std::index_sequence<I...>, std::tuple<Fields *...> &cols, size_type i, Args &&...args)
+    {
+        // 途中のカラムで例外が出たら、それまでに構築したカラムの要素を破棄して元に戻す
+        std::size_t constructed = 0;
+        try
+        {
+            ((std::construct_at(std::get<I>(cols) + i, std::forward<Args>(args)), ++constructed), ...);
+        }
+        catch (...)
+        {
+            ((I < constructed ? std::destroy_at(std::get<I>(cols) + i) : void()), ...);
+            throw;
+        }
+    }
+    template <std::size_t... I>
+    static void destroy_row(std::index_sequence<I...>, std::tuple<Fields *...> &cols, size_type i) noexcept
+    {
+        (std::destroy_at(std::get<I>(cols) + i), ...);
+    }
+    template <std::size_t... I>
+    reference row_at(std::index_sequence<I...>, size_type i) noexcept
+    {
+        return reference{{std::get<I>(columns)[i]...}};
+    }
+    template <std::size_t... I>
+    const_reference row_at(std::index_sequence<I...>, size_type i) const noexcept
+    {
+        return const_reference{{std::get<I>(columns)[i]...}};
+    }
+    // std::move_if_noexceptと同じ基準。moveが例外を投げうる型はcopyで移す
+    template <typename T>
+    static constexpr bool moves_on_relocate = std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>;
+
+    // Moveがtrueならmoveで移すカラムだけ、falseならcopyで移すカラムだけを移す
+    template <bool Move, std::size_t I>
+    void relocate_column(std::tuple<Fields *...> &fresh, bool *built)
+    {
+        using T = field_type<I>;
+        if constexpr (moves_on_relocate<T> == Move)
+        {
+            if constexpr (Move)
+            {
+                std::uninitialized_move_n(std::get<I>(columns), count, std::get<I>(fresh));
+            }
+            else
+            {
+                std::uninitialized_copy_n(std::get<I>(columns), count, std::get<I>(fresh));
+            }
+            built[I] = true;
+        }
+    }
+    // 例外を投げうるcopyのカラムを先に全て移し、元の要素に触るmoveはその後で行う
+    // これで途中で失敗しても元の要素は全て残る(強い保証)
+    // ただしcopyできず、moveが例外を投げうる型があると、std::vectorと同じく基本保証だけになる
+    // 失敗したらfreshに構築した要素は破棄する(領域の解放は呼び出し側)
+    template <std::size_t... I>
+    void relocate(std::index_sequence<I...>, std::tuple<Fields *...> &fresh)
+    {
+        bool built[sizeof...(Fields)] = {};
+        try
+        {
+            (relocate_column<false, I>(fresh, built), ...);
+            (relocate_column<true, I>(fresh, built), ...);
+        }
+        catch (...)
+        {
+            ((built[I] ? (void)std::destroy_n(std::get<I>(fresh), count) : void()), ...);
+            throw;
+        }
+    }
+};
+
+// budget回copyすると、次のcopyで例外を投げる
+struct fragile
+{
+    static inline int budget = 0;
+    int value;
+    fragile(int v) : value(v) {}
+    fragile(const fragile &r) : value(r.value)
+    {
+        if (budget-- == 0)
+        {
+            throw std::runtime_error("copy failed");
+        }
+    }
+};
+
+int main()
+{
+    // lockfreeのデモに出てくるperson{id, name}をカラムごとに持つ
+    soa_vector<int, std::string> people;
+    people.emplace_back(1, "a");
+    people.emplace_back(2, "b");
+    people.push_back({3, "c"});
+    people.push_back(std::make_tuple(4, std::string("d")));
+
+    for (auto row : people)
+    {
+        std::cout << row.get<0>() << ':' << row.get<1>() << ' ';
+    }
+    std::cout << std::endl;
+
+    // idのカラムだけを走査する。nameは一切触らない
+    auto ids = people.column<0>();
+    std::cout << "sum of ids: " << std::accumulate(ids.begin(), ids.end(), 0) << std::endl;
+
+    people[1].get<1>() = "B";
+    people.pop_back();
+    std::cout << people.size() << ' ' << people.back().get<1>() << ' ' << people[1].get<1>() << std::endl;
+
+    auto copy = people;
+    std::tuple<int, std::string> first = copy.front();
+    std::cout << std::get<0>(first) << ':' << std::get<1>(first) << std::endl;
+
+    // 自分の要素を積む。伸ばす時に古いカラムを解放する前に読む
+    soa_vector<int, std::string> self;
+    self.emplace_back(7, std::string(32, 'x'));
+    for (int i = 0; i != 5; ++i)
+    {
+        self.push_back(self[0]);
+    }
+    std::cout << self.size() << ' ' << self.capacity() << ' ' << self.back().get<1>().size() << std::endl;
+
+    // copyが途中で例外を投げても、moveで移すカラム(std::string)の元の要素は残る
+    soa_vector<std::string, fragile> rows;
+    rows.reserve(2);
+    rows.emplace_back(std::string(32, 'a'), 1);
+    rows.emplace_back(std::string(32, 'b'), 2);
+    fragile::budget = 1;
+    try
+    {
+        rows.emplace_back(std::string(32, 'c'), 3);
+    }
+    catch (const std::runtime_error &)
+    {
+        std::cout << "rolled back: ";
+    }
+    std::cout << rows.size() << ' ' << rows.capacity() << ' ' << rows[0].get<0>().size() << rows[1].get<0>().size() << std::endl;
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mpsc_queue.hpp"
+#include "queue.hpp"
+
+// ロガーのように、多くのスレッドが1つの消費者スレッドへレコードを送る
+struct log_record
+{
+    int thread = 0;
+    int seq = 0;
+    std::string text;
+    std::atomic<log_record *> next;
+};
+
+int main(int argc, char **argv)
+{
+    int producers = argc > 1 ? std::atoi(argv[1]) : 4;
+    int per_producer = argc > 2 ? std::atoi(argv[2]) : 100000;
+
+    {
+        lockfree::mpsc_queue<log_record, &log_record::next> q;
+        log_record a, b;
+        a.text = "a";
+        b.text = "b";
+        q.push(&a);
+        q.push(&b);
+        // a b 1
+        std::cout << q.pop()->text << ' ' << q.pop()->text << ' ' << (q.pop() == nullptr && q.empty()) << std::endl;
+    }
+
+    // nodeは生産者が確保し、消費者が解放する
+    lockfree::mpsc_queue<log_record, &log_record::next> q;
+    std::vector<std::thread> threads;
+    for (int p = 0; p != producers; ++p)
+    {
+        threads.emplace_back([&q, p, per_producer]
+                             {
+                                 for (int i = 0; i != per_producer; ++i)
+                                 {
+                                     auto r = new log_record;
+                                     r->thread = p;
+                                     r->seq = i;
+                                     q.push(r);
+                                 } });
+    }
+    long received = 0, out_of_order = 0;
+    std::vector<int> last(producers, -1);
+    while (received != static_cast<long>(producers) * per_producer)
+    {
+        auto r = q.pop();
+        if (r == nullptr)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (r->seq <= last[r->thread])
+        {
+            ++out_of_order;
+        }
+        last[r->thread] = r->seq;
+        ++received;
+        delete r;
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    std::cout << "received: " << received << " out of order: " << out_of_order << ' ' << q.empty() << std::endl;
+
+    // 生産者側のコストを比べる。mpsc_queueのnodeは先に確保しておき、lockfree::queueは要素ごとにキューの中でnewする
+    // (lockfree::queueは生産者と消費者を同時に動かすと、解放済みのnodeを生産者が読みうるので、積むのと取り出すのを分けている)
+    std::vector<log_record> records(static_cast<std::size_t>(producers) * per_producer);
+    auto time_producers = [&](auto push)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int p = 0; p != producers; ++p)
+        {
+            threads.emplace_back([&push, p, per_producer]
+                                 {
+                                     for (int i = 0; i != per_producer; ++i)
+                                     {
+                                         push(p * per_producer + i);
+                                     } });
+        }
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+        return received / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / 1e6;
+    };
+    auto mpsc = time_producers([&q, &records](int i)
+                               { q.push(&records[i]); });
+    lockfree::queue<int> general;
+    auto mpmc = time_producers([&general](int i)
+                               { general.enq(i); });
+    long drained = 0;
+    while (q.pop() != nullptr)
+    {
+        ++drained;
+    }
+    std::cout << "drained: " << drained << std::endl;
+    std::cout << "mpsc_queue::push:     " << mpsc << " M msg/s" << std::endl;
+    std::cout << "lockfree::queue::enq: " << mpmc << " M msg/s" << std::endl;
+}
@@ -0,0 +1,93 @@
+#ifndef LOCKFREE_MPSC_QUEUE_HPP
+#define LOCKFREE_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <concepts>
+
+#include "../trace/trace.hpp"
+
+// https://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+// をもとにしたintrusiveなMPSCキュー(生産者は複数、消費者は1つ)
+// * atomic_recycling_stackと同じく、要素自身が持つnextメンバでつなぐ。キューはnodeを確保も解放もしない
+// * pushはexchange 1回とstore 1回だけで、CASのループがない(wait-free)
+// * popは消費者だけが呼ぶので、frontは普通の変数でよく、atomicな読み書き以外の命令(RMW)を使わない
+// * 空になった時に消費者がつなぎ直すためのstub nodeをキュー自身が持つ。そのためany_tはデフォルト構築できる必要がある
+//
+// pushの途中(exchangeの後、前のnodeのnextに書く前)で生産者が止まっていると、
+// それより後にpushされた要素があってもpopはnullptrを返す。空でないことが分かっていても、popは失敗しうる
+namespace lockfree
+{
+    template <typename any_t, std::atomic<any_t *> any_t::*next>
+    class mpsc_queue
+    {
+        static_assert(std::default_initializable<any_t>, "mpsc_queue needs a default constructible stub node");
+
+        any_t stub{};
+        // 生産者がexchangeする側と、消費者だけが触る側を別のキャッシュラインに置く
+        alignas(64) std::atomic<any_t *> back;
+        alignas(64) any_t *front;
+
+    public:
+        mpsc_queue() : back(&stub), front(&stub)
+        {
+            (stub.*next).store(nullptr, std::memory_order_relaxed);
+        }
+        mpsc_queue(const mpsc_queue &) = delete;
+        mpsc_queue &operator=(const mpsc_queue &) = delete;
+
+        // どのスレッドからでも呼べる
+        void push(any_t *elem) noexcept
+        {
+            TRACE_SCOPE("lockfree::mpsc_queue::push");
+            (elem->*next).store(nullptr, std::memory_order_relaxed);
+            // ここでbackを自分のnodeにした時点で順番が決まる。前のnodeにつなぐのはその後でよい
+            any_t *prev = back.exchange(elem, std::memory_order_acq_rel);
+            (prev->*next).store(elem, std::memory_order_release);
+        }
+
+        // 消費者のスレッドだけが呼べる。取り出せなければnullptr
+        // 返したnodeに生産者が触ることはもうないので、すぐに解放や再利用をしてよい
+        any_t *pop() noexcept
+        {
+            TRACE_SCOPE("lockfree::mpsc_queue::pop");
+            any_t *first = front;
+            any_t *second = (first->*next).load(std::memory_order_acquire);
+            if (first == &stub)
+            {
+                if (second == nullptr)
+                {
+                    return nullptr;
+                }
+                front = first = second;
+                second = (first->*next).load(std::memory_order_acquire);
+            }
+            if (second != nullptr)
+            {
+                front = second;
+                return first;
+            }
+            // firstが最後のnodeに見える。本当に最後なら、stubを後ろにつないでからfirstを取り出す
+            if (first != back.load(std::memory_order_acquire))
+            {
+                // 生産者がpushの途中
+                return nullptr;
+            }
+            push(&stub);
+            second = (first->*next).load(std::memory_order_acquire);
+            if (second != nullptr)
+            {
+                front = second;
+                return first;
+            }
+            return nullptr;
+        }
+
+        // 消費者のスレッドから呼ぶ。pushの途中の要素は数えないので、falseでもpopが失敗することがある
+        bool empty() const noexcept
+        {
+            return front == &stub && (stub.*next).load(std::memory_order_acquire) == nullptr;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef LOCKFREE_QUEUE_HPP
+#define LOCKFREE_QUEUE_HPP
+
+#include <unistd.h> // usleep
+#include <iostream>
+#include <stdlib.h> // rand
+#include <atomic>
+#include <string>
+#include <utility>
+
+#include "../trace/trace.hpp"
+
+// https://github.com/kumagi/lockfree/blob/master/queue.hpp
+// をもとに、atomicを利用したり、ABA対応し、少しコードを変更しただけ
+
+namespace lockfree
+{
+
+    template <typename T>
+    class queue
+    {
+    private:
+        class Node
+        {
+        public:
+            const T mValue;
+            std::atomic<Node *> mNext;
+
+            Node(const T &v) : mValue(v), mNext(nullptr) {}
+            Node(T &&v) : mValue(std::move(v)), mNext(nullptr) {}
+            Node() : mValue(), mNext(nullptr) {}
+            Node(const Node &) = delete;
+            Node &operator=(const Node &) = delete;
+        };
+        std::atomic<Node *> mHead, mTail;
+
+        void link(Node *node)
+        {
+            while (1)
+            {
+                Node *last = mTail.load();
+                Node *next = last->mNext;
+                if (next == nullptr)
+                {
+                    if ((last->mNext).compare_exchange_weak(next, node))
+                    {
+                        mTail.compare_exchange_weak(last, node);
+                        return;
+                    }
+                }
+                else
+                {
+                    mTail.compare_exchange_weak(last, next);
+                }
+            }
+        }
+
+    public:
+        queue(const queue &) = delete;
+        queue &operator=(const queue &) = delete;
+        queue()
+        {
+            Node *sentinel = new Node();
+            mHead.store(sentinel);
+            mTail.store(sentinel);
+        }
+
+        void enq(const T &v)
+        {
+            TRACE_SCOPE("lockfree::queue::enq");
+            link(new Node(v));
+        }
+        // 値はnodeへmoveする。取り出す側はnodeの値をコピーする(他の消費者も同時に読みうるのでmoveできない)
+        void enq(T &&v)
+        {
+            TRACE_SCOPE("lockfree::queue::enq");
+            link(new Node(std::move(v)));
+        }
+        T deq()
+        {
+            TRACE_SCOPE("lockfree::queue::deq");
+            while (1)
+            {
+                Node *first = mHead.load();
+                Node *last = mTail.load();
+                Node *next = first->mNext;
+
+                if (first == last)
+                {
+                    if (next == nullptr)
+                    {
+                        while (mHead.load()->mNext == nullptr)
+                        {
+                            usleep(1);
+                        }
+                        continue;
+                    }
+                    mTail.compare_exchange_weak(last, next);
+                }
+                else
+                {
+                    // mHeadが指す先はsentinelなのでそのnextを返す
+                    T result = next->mValue;
+                    // sentinelを移動させる
+                    if (mHead.compare_exchange_weak(first, next))
+                    {
+                        delete first;
+                        return result;
+                    }
+                }
+            }
+        }
+
+        // deqと違い、空なら待たずにfalseを返す
+        bool try_deq(T &out)
+        {
+            TRACE_SCOPE("lockfree::queue::try_deq");
+            while (1)
+            {
+                Node *first = mHead.load();
+                Node *last = mTail.load();
+                Node *next = first->mNext;
+
+                if (first == last)
+                {
+                    if (next == nullptr)
+                    {
+                        return false;
+                    }
+                    mTail.compare_exchange_weak(last, next);
+                }
+                else
+                {
+                    T result = next->mValue;
+                    if (mHead.compare_exchange_weak(first, next))
+                    {
+                        delete first;
+                        out = std::move(result);
+                        return true;
+                    }
+                }
+            }
+        }
+
+        bool deq_delete()
+        {
+            while (1)
+            {
+                Node *first = mHead.load();
+                Node *last = mTail.load();
+                Node *next = first->mNext;
+
+                if (first == last)
+                {
+                    if (next == nullptr)
+                    {
+                        return false;
+                    }
+                    mTail.compare_exchange_weak(last, next);
+                }
+                else
+                {
+                    if (mHead.compare_exchange_weak(first, next))
+                    {
+                        delete first;
+                        return true;
+                    }
+                }
+            }
+        }
+        bool empty() const
+        {
+            return mHead.load()->mNext == nullptr;
+        }
+        bool size() const
+        {
+            const Node *it = mHead.load();
+            int num;
+            while (it != NULL)
+            {
+                it = it->mNext;
+                num++;
+            }
+            return num - 1;
+        }
+
+        ~queue()
+        {
+            while (deq_delete())
+                ;
+            delete mHead.load();
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <time.h> // clock_gettime
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "rcu.hpp"
+#include "../basic/smart_pointer.hpp"
+
+struct routing_table
+{
+    static inline std::atomic<int> alive{0};
+
+    int version = 0;
+    std::vector<int> routes = std::vector<int>(16, 0);
+
+    routing_table() { alive.fetch_add(1); }
+    routing_table(const routing_table &r) : version(r.version), routes(r.routes) { alive.fetch_add(1); }
+    ~routing_table() { alive.fetch_sub(1); }
+};
+
+// このスレッドが使ったCPU時間。スレッドがコア数より多いと経過時間では1回の読み出しのコストが分からない
+long long thread_cpu_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// readersスレッドがread(i)を呼び続け、1回あたりのCPU時間を返す
+template <typename Read>
+double nanoseconds_per_read(int readers, Read read)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<long long> total_ns{0}, total_reads{0}, sink{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t != readers; ++t)
+    {
+        threads.emplace_back([&]
+                             {
+                                 long long reads = 0;
+                                 long sum = 0;
+                                 auto start = thread_cpu_ns();
+                                 while (!stop.load(std::memory_order_relaxed))
+                                 {
+                                     for (int i = 0; i != 1000; ++i)
+                                     {
+                                         sum += read(i);
+                                     }
+                                     reads += 1000;
+                                 }
+                                 total_ns += thread_cpu_ns() - start;
+                                 total_reads += reads;
+                                 // 読んだ値を使ったことにして、読み出しごと消されないようにする
+                                 sink += sum; });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    stop = true;
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    return static_cast<double>(total_ns) / static_cast<double>(total_reads);
+}
+
+int main(int argc, char **argv)
+{
+    int max_readers = argc > 1 ? std::atoi(argv[1]) : 64;
+    {
+        // readerは常に1つの版を一貫して読み、writerはコピーを書き換えて差し替える
+        lockfree::rcu_cell<routing_table> table;
+        std::atomic<bool> stop{false};
+        std::atomic<long> torn{0};
+        std::vector<std::thread> readers;
+        for (int t = 0; t != 4; ++t)
+        {
+            readers.emplace_back([&]
+                                 {
+                                     while (!stop.load(std::memory_order_relaxed))
+                                     {
+                                         auto r = table.read();
+                                         for (auto route : r->routes)
+                                         {
+                                             if (route != r->version)
+                                             {
+                                                 torn.fetch_add(1);
+                                             }
+                                         }
+                                         // 入れ子にしてもよい
+                                         auto inner = table.read();
+                                         if (inner->version < r->version)
+                                         {
+                                             torn.fetch_add(1);
+                                         }
+                                     } });
+        }
+        for (int v = 1; v <= 1000; ++v)
+        {
+            table.update([v](routing_table &copy)
+                         {
+                             copy.version = v;
+                             for (auto &route : copy.routes)
+                             {
+                                 route = v;
+                             } });
+        }
+        stop = true;
+        for (auto &t : readers)
+        {
+            t.join();
+        }
+        lockfree::epoch_domain::instance().synchronize();
+        // 1000 0 0 1
+        std::cout << table.read()->version << ' ' << torn << ' ' << lockfree::epoch_domain::instance().pending() << ' ' << routing_table::alive << std::endl;
+    }
+    std::cout << "alive: " << routing_table::alive << std::endl;
+
+    // 読み出しのスケーリング。rcu_cellは別スレッドが10msごとに更新し続ける
+    std::cout << "readers  plain pointer  rcu_cell  atomic_shared_ptr  (ns/read)" << std::endl;
+    for (int readers = 1; readers <= max_readers; readers *= 2)
+    {
+        routing_table fixed;
+        std::atomic<routing_table *> plain{&fixed};
+        auto plain_ns = nanoseconds_per_read(readers, [&plain](int i)
+                                             { return plain.load(std::memory_order_acquire)->routes[i & 15]; });
+
+        lockfree::rcu_cell<routing_table> cell;
+        std::atomic<bool> stop{false};
+        std::thread writer([&]
+                           {
+                               while (!stop.load())
+                               {
+                                   cell.update([](routing_table &copy)
+                                               { ++copy.version; });
+                                   std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                               } });
+        auto rcu_ns = nanoseconds_per_read(readers, [&cell](int i)
+                                           { return cell.read()->routes[i & 15]; });
+        stop = true;
+        writer.join();
+
+        atomic_shared_ptr<routing_table> shared(make_shared<routing_table>());
+        auto shared_ns = nanoseconds_per_read(readers, [&shared](int i)
+                                              { return shared.load()->routes[i & 15]; });
+
+        std::cout << readers << "\t " << plain_ns << "\t\t" << rcu_ns << "\t  " << shared_ns << std::endl;
+    }
+}
@@ -0,0 +1,338 @@
+#ifndef LOCKFREE_RCU_HPP
+#define LOCKFREE_RCU_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../trace/trace.hpp"
+
+// 読み出しがほとんどで、更新はまれなデータ(ルーティング表や機能フラグ)のためのRCU
+// https://www.kernel.org/doc/html/latest/RCU/whatisRCU.html
+// * 読み出し側は、今のepochを自分のスロットに書いて(announce)からポインタを読むだけ。参照カウントは書かない
+// * 更新側は、コピーを作って書き換え、ポインタを差し替えてから古い版をretireする
+//   古い版は、差し替えた時点で読み出し中だったスレッドが全て抜けるまで解放しない(epoch-based reclamation)
+//
+// epochの規則
+// * 差し替えの後にglobal_epochを1進める。差し替え前のepochをeとして、古い版はeでretireする
+// * スロットが0(読み出し中でない)か、eより大きいepochを示していれば、そのスレッドは古い版を持っていない
+//   (eより大きいepochを読んだということは、差し替えの後に読み出しを始めている)
+//
+// 読み出し側のフェンス
+// スロットへの書き込みとポインタの読み出しの間には、store-loadの順序が必要(x86でもmfenceかxchgになる)
+// Linuxではmembarrier(2)を使って、このフェンスを更新側に移す。更新側が全スレッドにフェンスを打たせるので、
+// 読み出し側はコンパイラに並べ替えさせないだけでよく、普通の変数の読み書きと同じ命令になる
+// (ThreadSanitizerはmembarrierを理解しないので、その場合は読み出し側でフェンスを打つ)
+namespace lockfree
+{
+    class epoch_domain
+    {
+    public:
+        // スレッドごとのスロット。epochは読み出し中でなければ0
+        struct alignas(64) slot
+        {
+            std::atomic<std::uint64_t> epoch{0};
+            // 入れ子になった読み出しの深さ。持ち主のスレッドしか触らない
+            unsigned depth = 0;
+            std::atomic<bool> in_use{true};
+        };
+
+        static epoch_domain &instance()
+        {
+            static epoch_domain d;
+            return d;
+        }
+        epoch_domain(const epoch_domain &) = delete;
+        epoch_domain &operator=(const epoch_domain &) = delete;
+        ~epoch_domain()
+        {
+            for (auto &r : retired)
+            {
+                r.destroy(r.object);
+            }
+        }
+
+        static void enter() noexcept
+        {
+            auto s = local_slot;
+            if (s == nullptr) [[unlikely]]
+            {
+                s = attach();
+            }
+            if (s->depth++ != 0)
+            {
+                return;
+            }
+            // global_epochはacquireで読む。membarrierは割り込んだ時点での順序しか保証しないので、
+            // relaxedだとaarch64などでは後のポインタの読み出しがepochの読み出しより先に済みうる
+            // すると差し替え前の版を持ったまま新しいepochを書くことになり、その版が解放されてしまう
+            // (x86では普通のloadと同じ命令になる)
+            s->epoch.store(global_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+            if (asymmetric_fence.load(std::memory_order_relaxed))
+            {
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            }
+            else
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+        static void leave() noexcept
+        {
+            auto s = local_slot;
+            if (--s->depth == 0)
+            {
+                // 読み出した版への全てのアクセスが、0を書く前に終わっている
+                s->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        // 差し替えた後に呼ぶ。pは読み出し中のスレッドがいなくなってから解放される
+        template <typename T>
+        void retire(T *p)
+        {
+            retire(p, [](void *q)
+                   { delete static_cast<T *>(q); });
+        }
+        void retire(void *p, void (*destroy)(void *))
+        {
+            std::lock_guard lock(mutex);
+            // 差し替え(seq_cst)の後にepochを進める。これより後に読み出しを始めたスレッドは新しい版を読む
+            // retiredがepochの順に並ぶよう、ロックの中で進める
+            auto e = global_epoch.fetch_add(1, std::memory_order_seq_cst);
+            retired.push_back({p, destroy, e});
+        }
+
+        // 解放してよいものを全て解放し、その数を返す。待たない
+        std::size_t reclaim()
+        {
+            std::vector<retired_object> ready;
+            {
+                std::lock_guard lock(mutex);
+                if (retired.empty())
+                {
+                    return 0;
+                }
+                auto oldest = oldest_reader();
+                std::erase_if(retired, [&](const retired_object &r)
+                              {
+                                  if (r.epoch < oldest)
+                                  {
+                                      ready.push_back(r);
+                                      return true;
+                                  }
+                                  return false; });
+            }
+            // デストラクタはロックの外で呼ぶ
+            for (auto &r : ready)
+            {
+                r.destroy(r.object);
+            }
+            return ready.size();
+        }
+        // ここまでにretireしたものが全て解放されるまで待つ
+        // 読み出し中に呼ぶと、自分が抜けるのを待つことになって終わらない
+        void synchronize()
+        {
+            std::uint64_t target;
+            {
+                std::lock_guard lock(mutex);
+                if (retired.empty())
+                {
+                    return;
+                }
+                target = retired.back().epoch;
+            }
+            while (true)
+            {
+                reclaim();
+                {
+                    std::lock_guard lock(mutex);
+                    if (retired.empty() || retired.front().epoch > target)
+                    {
+                        return;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+        std::size_t pending()
+        {
+            std::lock_guard lock(mutex);
+            return retired.size();
+        }
+
+    private:
+        struct retired_object
+        {
+            void *object;
+            void (*destroy)(void *);
+            std::uint64_t epoch;
+        };
+
+        // 0は読み出し中でないことを表すので1から始める
+        static inline std::atomic<std::uint64_t> global_epoch{1};
+        static inline std::atomic<bool> asymmetric_fence{false};
+        static inline thread_local slot *local_slot = nullptr;
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<slot>> slots;
+        // epochの小さい順に並ぶ
+        std::vector<retired_object> retired;
+
+        epoch_domain()
+        {
+#if defined(__linux__) && !defined(__SANITIZE_THREAD__)
+            if (syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0)
+            {
+                asymmetric_fence.store(true, std::memory_order_relaxed);
+            }
+#endif
+        }
+
+        // スロットはスレッドの終了時に返し、次に作られたスレッドが使い回す
+        class thread_slot
+        {
+            slot *s;
+
+        public:
+            thread_slot() : s(instance().acquire()) {}
+            ~thread_slot()
+            {
+                local_slot = nullptr;
+                s->in_use.store(false, std::memory_order_release);
+            }
+            slot *get() const noexcept { return s; }
+        };
+        [[gnu::noinline]] static slot *attach()
+        {
+            thread_local thread_slot owner;
+            return local_slot = owner.get();
+        }
+        slot *acquire()
+        {
+            std::lock_guard lock(mutex);
+            for (auto &s : slots)
+            {
+                if (!s->in_use.load(std::memory_order_acquire))
+                {
+                    s->in_use.store(true, std::memory_order_relaxed);
+                    return s.get();
+                }
+            }
+            slots.push_back(std::make_unique<slot>());
+            return slots.back().get();
+        }
+
+        // 読み出し中のスレッドが示すepochの最小値。誰も読み出し中でなければ今のepoch
+        // mutexを持って呼ぶ
+        std::uint64_t oldest_reader()
+        {
+            TRACE_SCOPE("lockfree::epoch_domain::oldest_reader");
+            // 読み出し側が省いたフェンスを、全スレッドに打たせる
+#if defined(__linux__)
+            if (asymmetric_fence.load(std::memory_order_relaxed))
+            {
+                syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+            }
+#endif
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto oldest = global_epoch.load(std::memory_order_seq_cst);
+            for (auto &s : slots)
+            {
+                auto e = s->epoch.load(std::memory_order_acquire);
+                if (e != 0 && e < oldest)
+                {
+                    oldest = e;
+                }
+            }
+            return oldest;
+        }
+    };
+
+    // 読み出しの間、版が解放されないようにする
+    class rcu_read_guard
+    {
+    public:
+        rcu_read_guard() noexcept { epoch_domain::enter(); }
+        ~rcu_read_guard() { epoch_domain::leave(); }
+        rcu_read_guard(const rcu_read_guard &) = delete;
+        rcu_read_guard &operator=(const rcu_read_guard &) = delete;
+    };
+
+    // RCUで守られた値を1つ持つ
+    //   auto r = cell.read();           // rが生きている間、*rは解放されない
+    //   cell.update([](T &copy) { ... });  // コピーを書き換えて差し替える
+    template <typename T>
+    class rcu_cell
+    {
+    public:
+        class reader
+        {
+            rcu_read_guard guard;
+            const T *p;
+
+        public:
+            explicit reader(const std::atomic<T *> &current) noexcept : p(current.load(std::memory_order_acquire)) {}
+            const T &operator*() const noexcept { return *p; }
+            const T *operator->() const noexcept { return p; }
+            const T *get() const noexcept { return p; }
+        };
+
+        template <typename... Args>
+        explicit rcu_cell(Args &&...args) : current(new T(std::forward<Args>(args)...))
+        {
+        }
+        // 破棄する時には、このcellを読み出し中のスレッドがいてはいけない
+        ~rcu_cell()
+        {
+            delete current.load(std::memory_order_relaxed);
+        }
+        rcu_cell(const rcu_cell &) = delete;
+        rcu_cell &operator=(const rcu_cell &) = delete;
+
+        // wait-free。スロットにepochを書いてポインタを読むだけ
+        reader read() const noexcept
+        {
+            return reader(current);
+        }
+
+        // 更新どうしはmutexで順番にする。古い版の解放は待たない
+        template <typename F>
+        void update(F f)
+        {
+            std::lock_guard lock(writer);
+            auto copy = std::make_unique<T>(*current.load(std::memory_order_relaxed));
+            f(*copy);
+            publish(copy.release());
+        }
+        void store(T value)
+        {
+            std::lock_guard lock(writer);
+            publish(new T(std::move(value)));
+        }
+
+    private:
+        std::atomic<T *> current;
+        std::mutex writer;
+
+        void publish(T *fresh)
+        {
+            auto old = current.exchange(fresh, std::memory_order_seq_cst);
+            auto &domain = epoch_domain::instance();
+            domain.retire(old);
+            domain.reclaim();
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+#include "sharded_queue.hpp"
+#include "../trace/histogram.hpp"
+
+// 生産者ごとの連番を積み、各消費者が生産者ごとに昇順で受け取れているかを確かめる
+struct item
+{
+    int producer;
+    int seq;
+};
+
+// latenciesを渡すと、enq 1回ごとの時間も記録する(その分スループットは落ちる)
+template <typename Queue>
+double enqueue_seconds(Queue &q, int producers, int per_producer, trace::concurrent_histogram *latencies = nullptr)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p != producers; ++p)
+    {
+        threads.emplace_back([&q, p, per_producer, latencies]
+                             {
+                                 for (int i = 0; i != per_producer; ++i)
+                                 {
+                                     if (latencies == nullptr)
+                                     {
+                                         q.enq(item{p, i});
+                                         continue;
+                                     }
+                                     trace::histogram::timer t(latencies->local());
+                                     q.enq(item{p, i});
+                                 } });
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 消費者を動かしながら積み、全て受け取れたかと、生産者ごとの順序が崩れた数を返す
+template <typename Queue>
+std::pair<int, long> produce_and_consume(Queue &q, int producers, int consumers, int per_producer)
+{
+    std::atomic<int> remaining{producers * per_producer};
+    std::atomic<long> out_of_order{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c != consumers; ++c)
+    {
+        threads.emplace_back([&]
+                             {
+                                 std::vector<int> last(producers, -1);
+                                 item v;
+                                 while (remaining.load(std::memory_order_relaxed) > 0)
+                                 {
+                                     if (!q.try_deq(v))
+                                     {
+                                         std::this_thread::yield();
+                                         continue;
+                                     }
+                                     if (v.seq <= last[v.producer])
+                                     {
+                                         out_of_order.fetch_add(1);
+                                     }
+                                     last[v.producer] = v.seq;
+                                     remaining.fetch_sub(1, std::memory_order_relaxed);
+                                 } });
+    }
+    enqueue_seconds(q, producers, per_producer);
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    return {remaining.load(), out_of_order.load()};
+}
+
+int main(int argc, char **argv)
+{
+    int producers = argc > 1 ? std::atoi(argv[1]) : 4;
+    int consumers = argc > 2 ? std::atoi(argv[2]) : 4;
+    int per_producer = argc > 3 ? std::atoi(argv[3]) : 100000;
+
+    // 生産者は最初のenqでlaneを1本占有する。laneが生産者の数以上あれば、どの生産者もロックを取らずに積む
+    lockfree::sharded_queue<item> q(std::max<std::size_t>(producers, lockfree::sharded_queue<item>::default_lanes()));
+    std::cout << "lanes: " << q.lane_count() << std::endl;
+    auto [remaining, out_of_order] = produce_and_consume(q, producers, consumers, per_producer);
+    std::cout << "remaining: " << remaining << " out of order: " << out_of_order << std::endl;
+
+    // laneより生産者が多いと、占有できなかった生産者は共有laneにロックを取って積む
+    // per_cpuは同じCPUの生産者がlaneを共有するので常にロックを取る。どちらも取りこぼしはない(per_cpuは順序を保証しない)
+    {
+        lockfree::sharded_queue<item> few(std::max(producers / 2, 1));
+        auto [r, o] = produce_and_consume(few, producers, consumers, per_producer / 10);
+        std::cout << "fewer lanes:   remaining: " << r << " out of order: " << o << std::endl;
+        lockfree::sharded_queue<item> cpu(lockfree::sharded_queue<item>::default_lanes(), lockfree::sharded_queue<item>::lane_policy::per_cpu);
+        std::cout << "per_cpu:       remaining: " << produce_and_consume(cpu, producers, consumers, per_producer / 10).first << std::endl;
+    }
+
+    // 生産者だけを同時に動かし、1本のqueueとlaneに分けた場合の積む速さを比べる
+    {
+        lockfree::queue<item> single;
+        auto t = enqueue_seconds(single, producers, per_producer);
+        std::cout << "queue:         " << producers * per_producer / t / 1e6 << " M enq/s" << std::endl;
+    }
+    {
+        lockfree::sharded_queue<item> sharded(producers);
+        auto t = enqueue_seconds(sharded, producers, per_producer);
+        std::cout << "sharded_queue: " << producers * per_producer / t / 1e6 << " M enq/s" << std::endl;
+    }
+
+    // 平均では見えない、取り合いによる待ちの裾をパーセンタイルで比べる
+    auto report = [](const char *name, const trace::histogram &h)
+    {
+        std::cout << name << "p50 " << h.percentile(50) << " ns, p99 " << h.percentile(99)
+                  << " ns, p99.9 " << h.percentile(99.9) << " ns, max " << h.max() << " ns" << std::endl;
+    };
+    {
+        lockfree::queue<item> single;
+        trace::concurrent_histogram latencies;
+        enqueue_seconds(single, producers, per_producer, &latencies);
+        report("queue enq:         ", latencies.snapshot());
+    }
+    {
+        lockfree::sharded_queue<item> sharded(producers);
+        trace::concurrent_histogram latencies;
+        enqueue_seconds(sharded, producers, per_producer, &latencies);
+        report("sharded_queue enq: ", latencies.snapshot());
+    }
+}
@@ -0,0 +1,274 @@
+#ifndef LOCKFREE_SHARDED_QUEUE_HPP
+#define LOCKFREE_SHARDED_QUEUE_HPP
+
+#include <unistd.h> // usleep
+#include <sched.h>  // sched_getcpu
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "queue.hpp"
+
+namespace lockfree
+{
+    // lockfree::queueをK本(lane)並べたキュー
+    // queueはmHeadとmTailが1つずつしかないので、スレッドを増やしてもそこを取り合うだけで頭打ちになる
+    // laneに分ければ、取り合いはlaneごとに閉じる
+    // * 消費者はまずhome laneから取り出し、空なら他のlaneを順に見て取り出す(steal)
+    //   1つのlaneを同時に取り出す消費者は1つだけにしている。他の消費者が取り出し中のlaneは飛ばして次を見る
+    //   (queueはnodeをすぐにdeleteするので、同じlaneから複数の消費者が取り出すと解放済みのnodeを読みうる)
+    // * queueは生産者が複数いて消費者もいると、生産者が解放済みのmTailを読みうる。そのため1つのlaneに同時に積む生産者も1つにする
+    //
+    // 生産者とlane
+    // * per_thread(既定): 生産者は最初にenqした時に、このキューのlaneを1本占有する(スレッドが終わると返す)
+    //   占有したlaneには他の生産者は積まないので、ロックを取らずに積める
+    //   空いているlaneがなければ、共有lane(lane_countには数えない1本)にロックを取って積む
+    //   laneの数を同時に積む生産者の数以上にしておけば、共有laneは使われない
+    // * per_cpu: その時に動いているCPUのlaneに積む。キャッシュの局所性はよいが、同じCPUで動くスレッドが
+    //   同じlaneに積むので、常にlaneのロックを取る
+    //
+    // 順序の保証
+    // * per_thread: 1つの生産者が積んだ要素は、積んだ順に取り出される(生産者ごとのFIFO)
+    //   異なる生産者の要素の間の順序は保証しない(全体としてのFIFOではない)
+    // * per_cpu: スレッドがCPUを移ると別のlaneに積むことになるので、生産者ごとのFIFOも保証しない
+    template <typename T>
+    class sharded_queue
+    {
+    public:
+        enum class lane_policy
+        {
+            per_thread,
+            per_cpu,
+        };
+
+        // laneの数を省略するとCPU数にする
+        explicit sharded_queue(std::size_t lanes = default_lanes(), lane_policy policy = lane_policy::per_thread)
+            : num_lanes(lanes == 0 ? 1 : lanes), policy(policy), lanes(std::make_unique<lane[]>(num_lanes + 1)),
+              claims(std::make_shared<claim_table>(num_lanes)), id(next_id())
+        {
+        }
+        sharded_queue(const sharded_queue &) = delete;
+        sharded_queue &operator=(const sharded_queue &) = delete;
+
+        static std::size_t default_lanes()
+        {
+            auto n = std::thread::hardware_concurrency();
+            return n == 0 ? 1 : n;
+        }
+
+        void enq(const T &v)
+        {
+            push([&](queue<T> &q)
+                 { q.enq(v); });
+        }
+        void enq(T &&v)
+        {
+            push([&](queue<T> &q)
+                 { q.enq(std::move(v)); });
+        }
+        // 全てのlaneが空(または他の消費者が取り出し中)ならfalse
+        bool try_deq(T &out)
+        {
+            auto home = home_lane();
+            for (std::size_t i = 0; i != num_lanes + 1; ++i)
+            {
+                auto &l = lanes[(home + i) % (num_lanes + 1)];
+                // queue::emptyはmHeadの先を読むので、取り出し中の消費者がいるlaneでは呼べない
+                // 先にtestで見てから取りにいき、test_and_setの取り合いでキャッシュラインを汚さないようにする
+                if (l.consuming.test(std::memory_order_relaxed) || l.consuming.test_and_set(std::memory_order_acquire))
+                {
+                    continue;
+                }
+                auto found = !l.q.empty() && l.q.try_deq(out);
+                l.consuming.clear(std::memory_order_release);
+                if (found)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+        // 取り出せるまで待つ
+        T deq()
+        {
+            T v;
+            while (!try_deq(v))
+            {
+                usleep(1);
+            }
+            return v;
+        }
+
+        // 取り出し中の消費者がいるlaneは空でないとみなす
+        bool empty() const
+        {
+            for (std::size_t i = 0; i != num_lanes + 1; ++i)
+            {
+                auto &l = lanes[i];
+                if (l.consuming.test_and_set(std::memory_order_acquire))
+                {
+                    return false;
+                }
+                auto e = l.q.empty();
+                l.consuming.clear(std::memory_order_release);
+                if (!e)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        // 共有laneを除いたlaneの数
+        std::size_t lane_count() const noexcept
+        {
+            return num_lanes;
+        }
+
+        // 呼び出したスレッドが取り出しを始めるlane。生産者がどのlaneに積むかとは関係ない
+        std::size_t home_lane() const
+        {
+            if (policy == lane_policy::per_cpu)
+            {
+                auto cpu = sched_getcpu();
+                if (cpu >= 0)
+                {
+                    return static_cast<std::size_t>(cpu) % num_lanes;
+                }
+            }
+            return thread_slot() % num_lanes;
+        }
+
+    private:
+        // laneどうしが同じキャッシュラインに乗らないようにする
+        struct alignas(64) lane
+        {
+            queue<T> q;
+            std::atomic_flag consuming;
+            // 共有laneとper_cpuのlaneに積む生産者が取る
+            std::atomic_flag producing;
+        };
+
+        // laneを占有している生産者がいるか
+        // スレッドの終了時に返すので、キューより長生きしうる。そのためshared_ptrで持ち合う
+        struct claim_table
+        {
+            std::unique_ptr<std::atomic<bool>[]> claimed;
+            explicit claim_table(std::size_t n) : claimed(std::make_unique<std::atomic<bool>[]>(n)) {}
+        };
+
+        // スレッドごとの、キューのインスタンスから占有したlaneへの対応
+        struct registration
+        {
+            std::uint64_t queue_id;
+            // 占有できなければshared_lane
+            std::size_t lane;
+            std::shared_ptr<claim_table> claims;
+        };
+        static constexpr std::size_t shared_lane = std::size_t(-1);
+        class registry
+        {
+        public:
+            std::vector<registration> entries;
+            ~registry()
+            {
+                for (auto &r : entries)
+                {
+                    release(r);
+                }
+            }
+            static void release(registration &r) noexcept
+            {
+                if (r.lane != shared_lane)
+                {
+                    // このスレッドが積んだ分は、次に占有した生産者から見える
+                    r.claims->claimed[r.lane].store(false, std::memory_order_release);
+                }
+            }
+        };
+
+        std::size_t num_lanes;
+        lane_policy policy;
+        // 最後の1本が共有lane
+        std::unique_ptr<lane[]> lanes;
+        std::shared_ptr<claim_table> claims;
+        // アドレスは使い回されうるので、インスタンスごとに振る番号で区別する
+        std::uint64_t id;
+
+        static std::uint64_t next_id() noexcept
+        {
+            static std::atomic<std::uint64_t> next{0};
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        template <typename F>
+        void push(F f)
+        {
+            std::size_t i = policy == lane_policy::per_cpu ? home_lane() : producer_lane();
+            if (i != shared_lane && policy == lane_policy::per_thread)
+            {
+                f(lanes[i].q);
+                return;
+            }
+            auto &l = lanes[i == shared_lane ? num_lanes : i];
+            while (l.producing.test(std::memory_order_relaxed) || l.producing.test_and_set(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            f(l.q);
+            l.producing.clear(std::memory_order_release);
+        }
+
+        // 呼び出したスレッドが占有しているlane。初めてなら空いているlaneを探して占有する
+        std::size_t producer_lane()
+        {
+            thread_local registry local;
+            auto &entries = local.entries;
+            for (auto &r : entries)
+            {
+                if (r.queue_id == id)
+                {
+                    return r.lane;
+                }
+            }
+            // 破棄されたキューの分を捨てる(claimsを持っているのが自分だけならキューはもうない)
+            std::erase_if(entries, [](registration &r)
+                          {
+                              if (r.claims.use_count() == 1)
+                              {
+                                  registry::release(r);
+                                  return true;
+                              }
+                              return false; });
+            auto lane = shared_lane;
+            auto start = thread_slot() % num_lanes;
+            for (std::size_t k = 0; k != num_lanes; ++k)
+            {
+                auto i = (start + k) % num_lanes;
+                bool expected = false;
+                // 前の持ち主が積んだ分を見てから積む
+                if (!claims->claimed[i].load(std::memory_order_relaxed) &&
+                    claims->claimed[i].compare_exchange_strong(expected, true, std::memory_order_acquire))
+                {
+                    lane = i;
+                    break;
+                }
+            }
+            entries.push_back({id, lane, claims});
+            return lane;
+        }
+
+        // スレッドごとに一度だけ振る連番。キューのインスタンスによらず同じ値を使う
+        static std::size_t thread_slot()
+        {
+            static std::atomic<std::size_t> next{0};
+            thread_local std::size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+            return slot;
+        }
+    };
+};
+
+#endif
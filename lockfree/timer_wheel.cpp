@@ -0,0 +1,105 @@
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <random>
+#include "timer_wheel.hpp"
+#include "../trace/histogram.hpp"
+
+int main()
+{
+    using namespace std::chrono;
+    {
+        // tickを10usにして、1秒先まで(10万tick、2段目の1周を超える)のタイマーを4スレッドから入れる
+        // 半分は取り消す。取り消したものは呼ばれず、残りは期限より前には呼ばれない
+        lockfree::timer_wheel wheel(microseconds(10));
+        trace::histogram lateness;
+        std::atomic<int> early{0}, fired{0}, fired_after_cancel{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t != 4; ++t)
+        {
+            threads.emplace_back([&, t]
+                                 {
+                                     std::mt19937 rng(t);
+                                     for (int i = 0; i != 2500; ++i)
+                                     {
+                                         auto deadline = steady_clock::now() + microseconds(rng() % 1000000);
+                                         auto cancelled = std::make_shared<std::atomic<bool>>(false);
+                                         auto h = wheel.schedule_at(deadline, [&, deadline, cancelled]
+                                                                    {
+                                                                        auto late = steady_clock::now() - deadline;
+                                                                        if (late < nanoseconds(0))
+                                                                        {
+                                                                            early.fetch_add(1);
+                                                                        }
+                                                                        lateness.record(late);
+                                                                        if (cancelled->load())
+                                                                        {
+                                                                            fired_after_cancel.fetch_add(1);
+                                                                        }
+                                                                        fired.fetch_add(1); });
+                                         if (i % 2 == 1 && h.cancel())
+                                         {
+                                             cancelled->store(true);
+                                         }
+                                     } });
+        }
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+        std::this_thread::sleep_for(milliseconds(1100));
+        // 5000 0 0 0
+        std::cout << fired << ' ' << early << ' ' << fired_after_cancel << ' ' << wheel.pending() << std::endl;
+        std::cout << "lateness: p50 " << lateness.percentile(50) / 1000 << " us, p99 " << lateness.percentile(99) / 1000
+                  << " us, batches: " << wheel.batch_count() << " for " << wheel.fired_count() << " timers" << std::endl;
+    }
+    {
+        // 追加してすぐ取り消す(リトライやデッドラインのタイマーの大半はこうなる)
+        // 1つのmutexで守ったpriority_queueと、呼び出し側のスレッドのコストを比べる
+        constexpr int n = 200000;
+        lockfree::timer_wheel wheel;
+        auto start = steady_clock::now();
+        for (int i = 0; i != n; ++i)
+        {
+            auto h = wheel.schedule_after(seconds(1 + i % 60), [] {});
+            h.cancel();
+        }
+        auto wheel_ns = duration<double, std::nano>(steady_clock::now() - start).count() / n;
+
+        struct entry
+        {
+            steady_clock::time_point deadline;
+            std::shared_ptr<std::atomic<bool>> cancelled;
+            std::function<void()> callback;
+            bool operator<(const entry &r) const { return deadline > r.deadline; }
+        };
+        std::priority_queue<entry> heap;
+        std::mutex m;
+        start = steady_clock::now();
+        for (int i = 0; i != n; ++i)
+        {
+            auto cancelled = std::make_shared<std::atomic<bool>>(false);
+            {
+                std::lock_guard lock(m);
+                heap.push({steady_clock::now() + seconds(1 + i % 60), cancelled, [] {}});
+            }
+            // 取り消しは印を付けるだけで、期限まで残る
+            cancelled->store(true);
+        }
+        auto heap_ns = duration<double, std::nano>(steady_clock::now() - start).count() / n;
+        std::cout << "timer_wheel:         " << wheel_ns << " ns/schedule+cancel" << std::endl;
+        std::cout << "priority_queue+mutex: " << heap_ns << " ns/schedule+cancel, " << heap.size() << " entries left" << std::endl;
+    }
+    {
+        // ホイールより長生きしたhandleは、取り消し済みとして振る舞う
+        lockfree::timer_wheel::handle linked, queued;
+        {
+            lockfree::timer_wheel wheel;
+            linked = wheel.schedule_after(seconds(10), [] {});
+            std::this_thread::sleep_for(milliseconds(5));
+            queued = wheel.schedule_after(seconds(10), [] {});
+        }
+        // 0 0 0 0
+        std::cout << linked.pending() << ' ' << linked.cancel() << ' ' << queued.pending() << ' ' << queued.cancel() << std::endl;
+    }
+}
@@ -0,0 +1,373 @@
+#ifndef LOCKFREE_TIMER_WHEEL_HPP
+#define LOCKFREE_TIMER_WHEEL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mpsc_queue.hpp"
+#include "../basic/smart_pointer.hpp"
+#include "../trace/trace.hpp"
+
+// 階層タイマーホイール
+// http://www.cs.columbia.edu/~nahum/w6998/papers/sosp87-timing-wheels.pdf
+// * 1tickごとに1スロット進む、slot_count個のスロットを持つホイールをlevels段重ねる
+//   段Lの1スロットは段L-1の1周分。期限がずっと先のタイマーは上の段に入れ、その段のスロットに来た時に下の段へ入れ直す(cascade)
+// * 追加は期限から段とスロットを計算してリストにつなぐだけ、取り消しはリストから外すだけなのでどちらもO(1)
+//   std::priority_queueのようにO(log n)で、全体を1つのロックで守る必要もない
+//
+// スレッド
+// * ホイールを触るのはtickスレッドだけ。他のスレッドからの追加・取り消しはmpsc_queueに積むだけ(wait-free)
+//   tickスレッドは1tickごとにそれを取り出してホイールに反映してから時計を進める
+// * 期限が来たタイマーはそのtickの分をまとめて集め、ホイールの操作が全て終わってからコールバックを呼ぶ
+//   コールバックはtickスレッドで呼ばれるので、長い処理は別のスレッドに渡すこと
+namespace lockfree
+{
+    class timer_wheel
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        static constexpr unsigned slot_bits = 8;
+        static constexpr std::size_t slot_count = std::size_t(1) << slot_bits;
+        static constexpr unsigned levels = 4;
+
+    private:
+        struct timer : intrusive_ref_counter<timer>
+        {
+            enum state : std::uint8_t
+            {
+                pending,
+                cancelled,
+                fired,
+            };
+
+            std::function<void()> callback;
+            clock::time_point deadline{};
+            std::atomic<std::uint8_t> status{pending};
+            // 追加・取り消しを送るmpsc_queueのnext。取り消しは追加より先に届くことがあるので別々に持つ
+            std::atomic<timer *> submit_next{nullptr};
+            std::atomic<timer *> cancel_next{nullptr};
+            // ここから下はtickスレッドだけが触る
+            // スロットのリスト。pprevは前のnodeのwheel_next(先頭ならスロット自身)を指すので、自分だけで外せる
+            std::uint64_t expires = 0;
+            timer *wheel_next = nullptr;
+            timer **wheel_pprev = nullptr;
+
+            // 暗黙のデフォルトコンストラクタだと、timer_wheelの定義が終わるまでmpsc_queueから構築できると分からない
+            timer() {}
+        };
+
+    public:
+        // schedule_afterなどが返す。タイマーが発火・取り消しされた後も持っていてよい
+        class handle
+        {
+            intrusive_ptr<timer> t;
+            timer_wheel *wheel = nullptr;
+
+        public:
+            handle() = default;
+            handle(intrusive_ptr<timer> t, timer_wheel *wheel) : t(std::move(t)), wheel(wheel) {}
+
+            // 発火する前に取り消せた場合だけtrue
+            bool cancel()
+            {
+                if (!t)
+                {
+                    return false;
+                }
+                std::uint8_t expected = timer::pending;
+                if (!t->status.compare_exchange_strong(expected, timer::cancelled, std::memory_order_acq_rel))
+                {
+                    return false;
+                }
+                // ホイールから外すのはtickスレッドに任せる。キューにある間の参照を1つ持たせる
+                wheel->cancels.push(intrusive_ptr<timer>(t).detach());
+                return true;
+            }
+            bool pending() const noexcept
+            {
+                return t && t->status.load(std::memory_order_acquire) == timer::pending;
+            }
+            bool fired() const noexcept
+            {
+                return t && t->status.load(std::memory_order_acquire) == timer::fired;
+            }
+        };
+
+        explicit timer_wheel(clock::duration resolution = std::chrono::milliseconds(1))
+            : resolution(resolution), origin(clock::now())
+        {
+            ticker = std::thread([this]
+                                 { run(); });
+        }
+        // 発火していないタイマーは、コールバックを呼ばずに取り消し済みにして捨てる
+        // 残ったhandleのpending()はfalse、cancel()はfalseになり、破棄したホイールには触らない
+        ~timer_wheel()
+        {
+            stop.store(true, std::memory_order_release);
+            ticker.join();
+            drain_submits();
+            drain_cancels();
+            for (auto &level : slots)
+            {
+                for (auto &head : level)
+                {
+                    release_list(head);
+                }
+            }
+            release_list(overflow);
+        }
+        timer_wheel(const timer_wheel &) = delete;
+        timer_wheel &operator=(const timer_wheel &) = delete;
+
+        // どのスレッドからでも呼べる。期限は切り上げてtick単位にする
+        handle schedule_at(clock::time_point deadline, std::function<void()> callback)
+        {
+            auto t = make_intrusive<timer>();
+            t->callback = std::move(callback);
+            t->deadline = deadline;
+            submits.push(intrusive_ptr<timer>(t).detach());
+            return handle(std::move(t), this);
+        }
+        handle schedule_after(clock::duration delay, std::function<void()> callback)
+        {
+            return schedule_at(clock::now() + delay, std::move(callback));
+        }
+
+        // ホイールに入っているタイマーの数(tickスレッドが反映した分だけ)
+        std::size_t pending() const noexcept
+        {
+            return linked.load(std::memory_order_relaxed);
+        }
+        // これまでに発火したタイマーの数と、それを何回のtickに分けて呼んだか
+        std::uint64_t fired_count() const noexcept
+        {
+            return fired_total.load(std::memory_order_relaxed);
+        }
+        std::uint64_t batch_count() const noexcept
+        {
+            return batches.load(std::memory_order_relaxed);
+        }
+
+    private:
+        clock::duration resolution;
+        clock::time_point origin;
+        mpsc_queue<timer, &timer::submit_next> submits;
+        mpsc_queue<timer, &timer::cancel_next> cancels;
+        std::atomic<bool> stop{false};
+        std::atomic<std::size_t> linked{0};
+        std::atomic<std::uint64_t> fired_total{0}, batches{0};
+
+        // ここから下はtickスレッドだけが触る
+        // nowまでのtickは処理済み
+        std::uint64_t now = 0;
+        timer *slots[levels][slot_count]{};
+        // levels段で表せるより先のタイマー。一番上の段が1周するたびに入れ直す
+        timer *overflow = nullptr;
+        std::vector<intrusive_ptr<timer>> expired;
+
+        std::thread ticker;
+
+        std::uint64_t to_tick(clock::time_point deadline) const noexcept
+        {
+            if (deadline <= origin)
+            {
+                return 0;
+            }
+            auto d = deadline - origin;
+            return static_cast<std::uint64_t>((d + resolution - clock::duration(1)) / resolution);
+        }
+
+        static void link(timer *&head, timer *t) noexcept
+        {
+            t->wheel_next = head;
+            t->wheel_pprev = &head;
+            if (head != nullptr)
+            {
+                head->wheel_pprev = &t->wheel_next;
+            }
+            head = t;
+        }
+        static void unlink(timer *t) noexcept
+        {
+            *t->wheel_pprev = t->wheel_next;
+            if (t->wheel_next != nullptr)
+            {
+                t->wheel_next->wheel_pprev = t->wheel_pprev;
+            }
+            t->wheel_next = nullptr;
+            t->wheel_pprev = nullptr;
+        }
+        // リストをまるごと外し、つながっていた分の参照を返す(デストラクタから呼ぶ)
+        void release_list(timer *&head) noexcept
+        {
+            while (head != nullptr)
+            {
+                auto t = head;
+                unlink(t);
+                // handleがcancelでキューに積めないよう、取り消し済みにしておく
+                std::uint8_t expected = timer::pending;
+                t->status.compare_exchange_strong(expected, timer::cancelled, std::memory_order_acq_rel);
+                intrusive_ptr_release(t);
+                linked.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        // 参照はtに持たせたまま、ホイールにつなぐか期限切れに回す
+        void place(timer *t)
+        {
+            if (t->expires <= now)
+            {
+                expired.emplace_back(t, false);
+                linked.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            // nowと期限とで、上位のビットが初めて一致する段に入れる
+            // その段のスロットはnowより必ず先にあり、nowがそこに来た時に下の段へ入れ直される
+            for (unsigned level = 0; level != levels; ++level)
+            {
+                auto shift = slot_bits * (level + 1);
+                if ((t->expires >> shift) == (now >> shift))
+                {
+                    link(slots[level][(t->expires >> (slot_bits * level)) & (slot_count - 1)], t);
+                    return;
+                }
+            }
+            link(overflow, t);
+        }
+        // 段levelの、nowが指すスロットの中身を下の段へ入れ直す。上の段から先に行う
+        void cascade(unsigned level)
+        {
+            if (level == levels)
+            {
+                auto list = std::exchange(overflow, nullptr);
+                reinsert(list);
+                return;
+            }
+            auto index = (now >> (slot_bits * level)) & (slot_count - 1);
+            if (index == 0)
+            {
+                cascade(level + 1);
+            }
+            auto list = std::exchange(slots[level][index], nullptr);
+            reinsert(list);
+        }
+        void reinsert(timer *list)
+        {
+            if (list != nullptr)
+            {
+                list->wheel_pprev = &list;
+            }
+            while (list != nullptr)
+            {
+                auto t = list;
+                unlink(t);
+                place(t);
+            }
+        }
+
+        void drain_submits()
+        {
+            while (auto t = submits.pop())
+            {
+                // 反映する前に取り消されていれば、つながずに参照を返す
+                if (t->status.load(std::memory_order_acquire) != timer::pending)
+                {
+                    intrusive_ptr_release(t);
+                    continue;
+                }
+                t->expires = to_tick(t->deadline);
+                linked.fetch_add(1, std::memory_order_relaxed);
+                place(t);
+            }
+        }
+        void drain_cancels()
+        {
+            while (auto t = cancels.pop())
+            {
+                intrusive_ptr<timer> queued(t, false);
+                // まだ追加が反映されていないか、すでに期限切れとして外されていれば何もしない
+                if (t->wheel_pprev != nullptr)
+                {
+                    unlink(t);
+                    intrusive_ptr_release(t);
+                    linked.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        void advance(std::uint64_t target)
+        {
+            TRACE_SCOPE("lockfree::timer_wheel::advance");
+            while (now < target)
+            {
+                ++now;
+                if ((now & (slot_count - 1)) == 0)
+                {
+                    cascade(1);
+                }
+                auto list = std::exchange(slots[0][now & (slot_count - 1)], nullptr);
+                if (list != nullptr)
+                {
+                    list->wheel_pprev = &list;
+                }
+                while (list != nullptr)
+                {
+                    auto t = list;
+                    unlink(t);
+                    expired.emplace_back(t, false);
+                    linked.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+        }
+        void fire_expired()
+        {
+            if (expired.empty())
+            {
+                return;
+            }
+            std::uint64_t n = 0;
+            for (auto &t : expired)
+            {
+                // 取り消しとの競争に勝ったものだけ呼ぶ
+                std::uint8_t expected = timer::pending;
+                if (t->status.compare_exchange_strong(expected, timer::fired, std::memory_order_acq_rel))
+                {
+                    t->callback();
+                    ++n;
+                }
+            }
+            expired.clear();
+            fired_total.fetch_add(n, std::memory_order_relaxed);
+            batches.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void run()
+        {
+            auto next = origin;
+            while (!stop.load(std::memory_order_acquire))
+            {
+                next += resolution;
+                std::this_thread::sleep_until(next);
+                drain_submits();
+                drain_cancels();
+                // 眠りすぎた分もまとめて進める
+                auto current = clock::now();
+                advance(static_cast<std::uint64_t>((current - origin) / resolution));
+                fire_expired();
+                // コールバックが長引いて遅れた分は取り戻そうとしない
+                if (next < current - resolution)
+                {
+                    next = current;
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <bench/benchmark.hpp>
+#include <basic/array.hpp>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <vector>
+
+// basic/array.hppのarray・static_vectorとstdの比較
+namespace
+{
+    constexpr std::size_t count = 256;
+
+    template <typename Array>
+    void fill_sum(bench::state &state)
+    {
+        Array a{};
+        for (auto _ : state)
+        {
+            std::iota(a.begin(), a.end(), 0);
+            bench::do_not_optimize(a);
+            auto sum = std::accumulate(a.begin(), a.end(), 0L);
+            bench::do_not_optimize(sum);
+        }
+    }
+
+    // 容量が固定のstatic_vectorと、reserveしたstd::vector(毎回ヒープ確保あり)の比較
+    void static_vector_push_back(bench::state &state)
+    {
+        for (auto _ : state)
+        {
+            static_vector<int, count> v;
+            for (std::size_t i = 0; i != count; ++i)
+            {
+                v.push_back(static_cast<int>(i));
+            }
+            bench::do_not_optimize(v);
+        }
+    }
+    void std_vector_push_back(bench::state &state)
+    {
+        for (auto _ : state)
+        {
+            std::vector<int> v;
+            v.reserve(count);
+            for (std::size_t i = 0; i != count; ++i)
+            {
+                v.push_back(static_cast<int>(i));
+            }
+            bench::do_not_optimize(v[0]);
+        }
+    }
+
+    template <typename Array>
+    Array shuffled()
+    {
+        Array a{};
+        std::uint32_t x = 12345;
+        for (auto &v : a)
+        {
+            x = x * 1103515245u + 12345u;
+            v = static_cast<int>(x >> 8);
+        }
+        return a;
+    }
+    // arrayのイテレータをstd::sortに渡す(contiguous iteratorなのでstd::arrayと同じコードになるはず)
+    void array_sort(bench::state &state)
+    {
+        const auto original = shuffled<array<int, count>>();
+        for (auto _ : state)
+        {
+            auto a = original;
+            std::sort(a.begin(), a.end());
+            bench::do_not_optimize(a);
+        }
+    }
+    void std_sort(bench::state &state)
+    {
+        const auto original = shuffled<std::array<int, count>>();
+        for (auto _ : state)
+        {
+            auto a = original;
+            std::sort(a.begin(), a.end());
+            bench::do_not_optimize(a);
+        }
+    }
+}
+
+BENCHMARK("array/fill_sum", fill_sum<array<int, count>>);
+BENCHMARK("std::array/fill_sum", fill_sum<std::array<int, count>>);
+BENCHMARK("static_vector/push_back", static_vector_push_back);
+BENCHMARK("std::vector/reserved_push_back", std_vector_push_back);
+BENCHMARK("array/std::sort", array_sort);
+BENCHMARK("std::array/std::sort", std_sort);
@@ -0,0 +1,501 @@
+#include <bench/benchmark.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// ベンチマークのランナー
+//   benchmark [--filter=str] [--repetitions=N] [--min-time-ms=N] [--warmup-ms=N]
+//             [--json=out.json] [--baseline=base.json] [--threshold=percent] [--list]
+// * 各ベンチマークは、まずwarmupの時間だけ回し(キャッシュ・分岐予測・CPUクロックを安定させる)、
+//   その間に1回の計測がmin-timeを超えるiteration数を決める
+// * そのiteration数でrepetitions回計測し、1 iterationあたりの時間のmin/median/mean/max/stddevを出す
+// * --baselineを指定すると、以前に--jsonで保存した結果とmedianを比べ、threshold%より遅くなったものを
+//   REGRESSIONとして表示し、終了コードを1にする
+namespace bench
+{
+    namespace
+    {
+        struct entry
+        {
+            std::string name;
+            function fn;
+        };
+        std::vector<entry> &registry()
+        {
+            static std::vector<entry> entries;
+            return entries;
+        }
+
+        struct options
+        {
+            std::string filter;
+            int repetitions = 10;
+            double min_time_ms = 20;
+            double warmup_ms = 50;
+            std::string json_path;
+            std::string baseline_path;
+            double threshold = 10;
+            bool list = false;
+        };
+
+        struct result
+        {
+            std::string name;
+            std::uint64_t iterations = 0;
+            int repetitions = 0;
+            double min_ns = 0;
+            double median_ns = 0;
+            double mean_ns = 0;
+            double max_ns = 0;
+            double stddev_ns = 0;
+        };
+
+        double run_once(function fn, std::uint64_t iterations)
+        {
+            state s(iterations);
+            fn(s);
+            return static_cast<double>(s.elapsed().count());
+        }
+
+        // warmupを兼ねて、1回の計測がmin_timeを超えるiteration数を探す
+        std::uint64_t calibrate(function fn, const options &opt)
+        {
+            const double min_ns = opt.min_time_ms * 1e6;
+            const double warmup_ns = opt.warmup_ms * 1e6;
+            std::uint64_t iterations = 1;
+            double spent = 0;
+            while (true)
+            {
+                auto t = run_once(fn, iterations);
+                spent += t;
+                if (t >= min_ns)
+                {
+                    if (spent >= warmup_ns)
+                    {
+                        return iterations;
+                    }
+                    continue;
+                }
+                // 短すぎる計測からの見積もりはぶれるので、一度に増やすのは10倍まで
+                auto scale = t <= 0 ? 10.0 : std::min(10.0, min_ns * 1.2 / t);
+                iterations = std::max<std::uint64_t>(iterations + 1, static_cast<std::uint64_t>(static_cast<double>(iterations) * scale));
+            }
+        }
+
+        result measure(const entry &e, const options &opt)
+        {
+            auto iterations = calibrate(e.fn, opt);
+            std::vector<double> per_iteration;
+            for (int r = 0; r != opt.repetitions; ++r)
+            {
+                per_iteration.push_back(run_once(e.fn, iterations) / static_cast<double>(iterations));
+            }
+            std::sort(per_iteration.begin(), per_iteration.end());
+
+            result res;
+            res.name = e.name;
+            res.iterations = iterations;
+            res.repetitions = opt.repetitions;
+            auto n = per_iteration.size();
+            res.min_ns = per_iteration.front();
+            res.max_ns = per_iteration.back();
+            res.median_ns = n % 2 == 1 ? per_iteration[n / 2] : (per_iteration[n / 2 - 1] + per_iteration[n / 2]) / 2;
+            double sum = 0;
+            for (auto x : per_iteration)
+            {
+                sum += x;
+            }
+            res.mean_ns = sum / static_cast<double>(n);
+            double sq = 0;
+            for (auto x : per_iteration)
+            {
+                sq += (x - res.mean_ns) * (x - res.mean_ns);
+            }
+            res.stddev_ns = n > 1 ? std::sqrt(sq / static_cast<double>(n - 1)) : 0;
+            return res;
+        }
+
+        std::string escape(std::string_view s)
+        {
+            std::string out;
+            for (char c : s)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out += '\\';
+                }
+                out += c;
+            }
+            return out;
+        }
+
+        void write_json(std::ostream &os, const std::vector<result> &results, const options &opt)
+        {
+            os << "{\n  \"context\": {\"repetitions\": " << opt.repetitions
+               << ", \"min_time_ms\": " << opt.min_time_ms
+               << ", \"compiler\": \"" << escape(__VERSION__) << "\"},\n"
+               << "  \"benchmarks\": [";
+            os << std::setprecision(6) << std::fixed;
+            for (std::size_t i = 0; i != results.size(); ++i)
+            {
+                const auto &r = results[i];
+                os << (i == 0 ? "\n" : ",\n")
+                   << "    {\"name\": \"" << escape(r.name) << "\", \"iterations\": " << r.iterations
+                   << ", \"repetitions\": " << r.repetitions
+                   << ", \"min_ns\": " << r.min_ns << ", \"median_ns\": " << r.median_ns
+                   << ", \"mean_ns\": " << r.mean_ns << ", \"max_ns\": " << r.max_ns
+                   << ", \"stddev_ns\": " << r.stddev_ns << "}";
+            }
+            os << "\n  ]\n}\n";
+        }
+
+        // write_jsonが出力した形式を読むための最小限のJSONパーサ
+        // benchmarks配列の各オブジェクトから、nameと数値のフィールドだけを取り出す
+        class json_reader
+        {
+            std::string_view s;
+            std::size_t i = 0;
+
+            [[noreturn]] void fail(const char *what) const
+            {
+                throw std::runtime_error(std::string("baseline: ") + what + " at offset " + std::to_string(i));
+            }
+            void skip_ws()
+            {
+                while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i])))
+                {
+                    ++i;
+                }
+            }
+            bool consume(char c)
+            {
+                skip_ws();
+                if (i < s.size() && s[i] == c)
+                {
+                    ++i;
+                    return true;
+                }
+                return false;
+            }
+            void expect(char c)
+            {
+                if (!consume(c))
+                {
+                    fail("unexpected character");
+                }
+            }
+            std::string string()
+            {
+                expect('"');
+                std::string out;
+                while (i < s.size() && s[i] != '"')
+                {
+                    if (s[i] == '\\' && i + 1 < s.size())
+                    {
+                        ++i;
+                    }
+                    out += s[i++];
+                }
+                expect('"');
+                return out;
+            }
+            double number()
+            {
+                skip_ws();
+                auto begin = i;
+                while (i < s.size() && (std::isdigit(static_cast<unsigned char>(s[i])) || std::string_view("+-.eE").find(s[i]) != std::string_view::npos))
+                {
+                    ++i;
+                }
+                if (begin == i)
+                {
+                    fail("number expected");
+                }
+                return std::stod(std::string(s.substr(begin, i - begin)));
+            }
+            // 読み飛ばすだけの値
+            void skip_value()
+            {
+                skip_ws();
+                if (i >= s.size())
+                {
+                    fail("unexpected end");
+                }
+                if (s[i] == '"')
+                {
+                    string();
+                }
+                else if (consume('{'))
+                {
+                    if (!consume('}'))
+                    {
+                        do
+                        {
+                            string();
+                            expect(':');
+                            skip_value();
+                        } while (consume(','));
+                        expect('}');
+                    }
+                }
+                else if (consume('['))
+                {
+                    if (!consume(']'))
+                    {
+                        do
+                        {
+                            skip_value();
+                        } while (consume(','));
+                        expect(']');
+                    }
+                }
+                else if (std::isalpha(static_cast<unsigned char>(s[i])))
+                {
+                    while (i < s.size() && std::isalpha(static_cast<unsigned char>(s[i])))
+                    {
+                        ++i;
+                    }
+                }
+                else
+                {
+                    number();
+                }
+            }
+            result benchmark()
+            {
+                result r;
+                expect('{');
+                if (consume('}'))
+                {
+                    return r;
+                }
+                do
+                {
+                    auto key = string();
+                    expect(':');
+                    if (key == "name")
+                    {
+                        r.name = string();
+                    }
+                    else if (key == "median_ns")
+                    {
+                        r.median_ns = number();
+                    }
+                    else if (key == "min_ns")
+                    {
+                        r.min_ns = number();
+                    }
+                    else if (key == "max_ns")
+                    {
+                        r.max_ns = number();
+                    }
+                    else
+                    {
+                        skip_value();
+                    }
+                } while (consume(','));
+                expect('}');
+                return r;
+            }
+
+        public:
+            explicit json_reader(std::string_view s) : s(s) {}
+
+            std::map<std::string, result> read()
+            {
+                std::map<std::string, result> out;
+                expect('{');
+                do
+                {
+                    auto key = string();
+                    expect(':');
+                    if (key != "benchmarks")
+                    {
+                        skip_value();
+                        continue;
+                    }
+                    expect('[');
+                    if (consume(']'))
+                    {
+                        continue;
+                    }
+                    do
+                    {
+                        auto r = benchmark();
+                        out[r.name] = r;
+                    } while (consume(','));
+                    expect(']');
+                } while (consume(','));
+                expect('}');
+                return out;
+            }
+        };
+
+        std::map<std::string, result> read_baseline(const std::string &path)
+        {
+            std::ifstream in(path);
+            if (!in)
+            {
+                throw std::runtime_error("cannot open baseline: " + path);
+            }
+            std::stringstream ss;
+            ss << in.rdbuf();
+            auto text = ss.str();
+            return json_reader(text).read();
+        }
+
+        // 遅くなったものがあればtrue
+        bool compare(const std::vector<result> &results, const std::map<std::string, result> &baseline, const options &opt)
+        {
+            bool regressed = false;
+            std::cout << "\ncompared with " << opt.baseline_path << " (threshold " << opt.threshold << "%)\n";
+            for (const auto &r : results)
+            {
+                auto it = baseline.find(r.name);
+                std::cout << std::left << std::setw(40) << r.name << std::right;
+                if (it == baseline.end() || it->second.median_ns <= 0)
+                {
+                    std::cout << "  (not in baseline)\n";
+                    continue;
+                }
+                auto change = (r.median_ns / it->second.median_ns - 1) * 100;
+                std::cout << std::setw(12) << std::fixed << std::setprecision(2) << it->second.median_ns
+                          << " -> " << std::setw(12) << r.median_ns << " ns "
+                          << std::showpos << std::setw(8) << change << '%' << std::noshowpos;
+                // 今回の最速でも基準のmedianより遅い場合だけを回帰とし、ばらつきによる誤検出を減らす
+                if (change > opt.threshold && r.min_ns > it->second.median_ns)
+                {
+                    std::cout << "  REGRESSION";
+                    regressed = true;
+                }
+                else if (change < -opt.threshold)
+                {
+                    std::cout << "  improved";
+                }
+                std::cout << '\n';
+            }
+            return regressed;
+        }
+
+        options parse(int argc, char **argv)
+        {
+            options opt;
+            for (int i = 1; i < argc; ++i)
+            {
+                std::string_view arg = argv[i];
+                auto value = [&](std::string_view key) -> std::string_view
+                {
+                    return arg.substr(key.size());
+                };
+                if (arg.starts_with("--filter="))
+                {
+                    opt.filter = value("--filter=");
+                }
+                else if (arg.starts_with("--repetitions="))
+                {
+                    opt.repetitions = std::max(1, std::stoi(std::string(value("--repetitions="))));
+                }
+                else if (arg.starts_with("--min-time-ms="))
+                {
+                    opt.min_time_ms = std::stod(std::string(value("--min-time-ms=")));
+                }
+                else if (arg.starts_with("--warmup-ms="))
+                {
+                    opt.warmup_ms = std::stod(std::string(value("--warmup-ms=")));
+                }
+                else if (arg.starts_with("--json="))
+                {
+                    opt.json_path = value("--json=");
+                }
+                else if (arg.starts_with("--baseline="))
+                {
+                    opt.baseline_path = value("--baseline=");
+                }
+                else if (arg.starts_with("--threshold="))
+                {
+                    opt.threshold = std::stod(std::string(value("--threshold=")));
+                }
+                else if (arg == "--list")
+                {
+                    opt.list = true;
+                }
+                else
+                {
+                    throw std::invalid_argument("unknown option: " + std::string(arg));
+                }
+            }
+            return opt;
+        }
+    }
+
+    bool register_benchmark(std::string name, function fn)
+    {
+        registry().push_back({std::move(name), fn});
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace bench;
+    try
+    {
+        auto opt = parse(argc, argv);
+        // 比較対象の読み込みに失敗するなら、計測する前に分かった方がよい
+        std::map<std::string, result> baseline;
+        if (!opt.baseline_path.empty())
+        {
+            baseline = read_baseline(opt.baseline_path);
+        }
+
+        std::vector<result> results;
+        for (const auto &e : registry())
+        {
+            if (e.name.find(opt.filter) == std::string::npos)
+            {
+                continue;
+            }
+            if (opt.list)
+            {
+                std::cout << e.name << '\n';
+                continue;
+            }
+            auto r = measure(e, opt);
+            std::cout << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << r.median_ns << " ns/op  (min " << r.min_ns << ", max " << r.max_ns
+                      << ", stddev " << r.stddev_ns << ", " << r.iterations << " iterations)" << std::endl;
+            results.push_back(r);
+        }
+
+        if (!opt.json_path.empty())
+        {
+            std::ofstream out(opt.json_path);
+            write_json(out, results, opt);
+            if (!out)
+            {
+                throw std::runtime_error("cannot write " + opt.json_path);
+            }
+        }
+        if (!opt.baseline_path.empty() && compare(results, baseline, opt))
+        {
+            return 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+}
@@ -0,0 +1,63 @@
+#include <bench/benchmark.hpp>
+#include <basic/flat_hash_map.hpp>
+
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// basic/flat_hash_map.hppのflat_hash_mapとstd::unordered_mapの比較
+namespace
+{
+    constexpr std::size_t count = 100000;
+
+    // 半分は存在するキー、半分は存在しないキー
+    const std::vector<std::uint64_t> &keys()
+    {
+        static const auto k = []
+        {
+            std::mt19937_64 rng(1);
+            std::vector<std::uint64_t> v(2 * count);
+            for (auto &x : v)
+            {
+                x = rng();
+            }
+            return v;
+        }();
+        return k;
+    }
+
+    template <typename Map>
+    void find(bench::state &state)
+    {
+        Map m;
+        for (std::size_t i = 0; i != count; ++i)
+        {
+            m.try_emplace(keys()[i], i);
+        }
+        std::size_t i = 0;
+        for (auto _ : state)
+        {
+            bench::do_not_optimize(m.find(keys()[i]) != m.end());
+            i = i + 1 == keys().size() ? 0 : i + 1;
+        }
+    }
+    template <typename Map>
+    void insert(bench::state &state)
+    {
+        for (auto _ : state)
+        {
+            Map m;
+            for (std::size_t i = 0; i != 1000; ++i)
+            {
+                m.try_emplace(keys()[i], i);
+            }
+            bench::do_not_optimize(m);
+        }
+    }
+}
+
+BENCHMARK("flat_hash_map/find", find<flat_hash_map<std::uint64_t, std::size_t>>);
+BENCHMARK("std::unordered_map/find", find<std::unordered_map<std::uint64_t, std::size_t>>);
+BENCHMARK("flat_hash_map/insert_1000", insert<flat_hash_map<std::uint64_t, std::size_t>>);
+BENCHMARK("std::unordered_map/insert_1000", insert<std::unordered_map<std::uint64_t, std::size_t>>);
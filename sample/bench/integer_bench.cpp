@@ -0,0 +1,113 @@
+#include <bench/benchmark.hpp>
+#include <basic/my_integer.hpp>
+
+#include <stdexcept>
+#include <string>
+
+// basic/my_integer.hppのIntegerの計測
+// 標準には多倍長整数がないので、64bitに収まる値ではlong longと比べる
+namespace
+{
+    void integer_add_small(bench::state &state)
+    {
+        Integer a(123456789), b(987654321), sum(0);
+        for (auto _ : state)
+        {
+            sum += a;
+            sum -= b;
+            bench::do_not_optimize(sum);
+        }
+    }
+    // 2^32以上2^63未満の値。limbを2つとも使うが、和が64bitに収まる限りヒープを使わない
+    void integer_add_word(bench::state &state)
+    {
+        Integer a(0x123456789abcdLL), b(0x123456789abcdLL), sum(1LL << 40);
+        for (auto _ : state)
+        {
+            sum += a;
+            sum -= b;
+            bench::do_not_optimize(sum);
+        }
+        if (!sum.is_inline())
+        {
+            throw std::logic_error("Integer/add_word: a 64-bit sum moved to the heap.");
+        }
+    }
+    void long_long_add(bench::state &state)
+    {
+        long long a = 123456789, b = 987654321, sum = 0;
+        for (auto _ : state)
+        {
+            bench::do_not_optimize(a);
+            sum += a;
+            sum -= b;
+            bench::do_not_optimize(sum);
+        }
+    }
+
+    Integer digits(std::size_t n, char first)
+    {
+        std::string s(n, '7');
+        s[0] = first;
+        return Integer(s);
+    }
+    // 4項の足し算。式テンプレートで1回のループにまとめたものと、1項ずつ足したもの
+    void integer_add_chain(bench::state &state)
+    {
+        auto a = digits(300, '1'), b = digits(300, '2'), c = digits(300, '3'), d = digits(300, '4');
+        for (auto _ : state)
+        {
+            Integer r = a + b + c + d;
+            bench::do_not_optimize(r);
+        }
+    }
+    void integer_add_stepwise(bench::state &state)
+    {
+        auto a = digits(300, '1'), b = digits(300, '2'), c = digits(300, '3'), d = digits(300, '4');
+        for (auto _ : state)
+        {
+            Integer r = a;
+            r += b;
+            r += c;
+            r += d;
+            bench::do_not_optimize(r);
+        }
+    }
+    // 約2000bitどうしなのでKaratsubaで掛ける
+    void integer_multiply(bench::state &state)
+    {
+        auto a = digits(600, '3'), b = digits(600, '5');
+        for (auto _ : state)
+        {
+            auto r = a * b;
+            bench::do_not_optimize(r);
+        }
+    }
+    void integer_divide(bench::state &state)
+    {
+        auto a = digits(1200, '9'), b = digits(500, '3');
+        for (auto _ : state)
+        {
+            auto r = a / b;
+            bench::do_not_optimize(r);
+        }
+    }
+    void integer_to_string(bench::state &state)
+    {
+        auto a = digits(300, '8');
+        for (auto _ : state)
+        {
+            auto s = a.to_string();
+            bench::do_not_optimize(s);
+        }
+    }
+}
+
+BENCHMARK("Integer/add_small", integer_add_small);
+BENCHMARK("Integer/add_word", integer_add_word);
+BENCHMARK("long long/add", long_long_add);
+BENCHMARK("Integer/add_chain_300_digits", integer_add_chain);
+BENCHMARK("Integer/add_stepwise_300_digits", integer_add_stepwise);
+BENCHMARK("Integer/multiply_600_digits", integer_multiply);
+BENCHMARK("Integer/divide_1200_by_500_digits", integer_divide);
+BENCHMARK("Integer/to_string_300_digits", integer_to_string);
@@ -0,0 +1,185 @@
+#include <bench/benchmark.hpp>
+#include <lockfree/mpsc_queue.hpp>
+#include <lockfree/queue.hpp>
+#include <lockfree/rcu.hpp>
+#include <lockfree/sharded_queue.hpp>
+#include <lockfree/stack.hpp>
+#include <trace/histogram.hpp>
+
+#include <mutex>
+#include <queue>
+#include <stack>
+
+// lockfree/のqueue・stackと、std::queue・std::stackをmutexで守ったものとの比較
+// 1スレッドでの操作1回あたりのコスト(競合なし)を測る
+namespace
+{
+    constexpr int count = 64;
+
+    void lockfree_queue(bench::state &state)
+    {
+        lockfree::queue<int> q;
+        for (auto _ : state)
+        {
+            for (int i = 0; i != count; ++i)
+            {
+                q.enq(i);
+            }
+            for (int i = 0; i != count; ++i)
+            {
+                bench::do_not_optimize(q.deq());
+            }
+        }
+    }
+    // laneを1本にしたsharded_queue。queueに比べて生産者が占有したlaneの検索と消費者のtry-lockの分だけ遅くなる
+    void sharded_queue(bench::state &state)
+    {
+        lockfree::sharded_queue<int> q(1);
+        int v = 0;
+        for (auto _ : state)
+        {
+            for (int i = 0; i != count; ++i)
+            {
+                q.enq(i);
+            }
+            for (int i = 0; i != count; ++i)
+            {
+                q.try_deq(v);
+                bench::do_not_optimize(v);
+            }
+        }
+    }
+    void std_queue_mutex(bench::state &state)
+    {
+        std::queue<int> q;
+        std::mutex m;
+        for (auto _ : state)
+        {
+            for (int i = 0; i != count; ++i)
+            {
+                std::lock_guard lock(m);
+                q.push(i);
+            }
+            for (int i = 0; i != count; ++i)
+            {
+                std::lock_guard lock(m);
+                bench::do_not_optimize(q.front());
+                q.pop();
+            }
+        }
+    }
+
+    struct node
+    {
+        int value;
+        node *next;
+    };
+    // atomic_recycling_stackは要素を確保しないので、ノードは先に用意しておく
+    void lockfree_stack(bench::state &state)
+    {
+        atomic_recycling_stack<node, &node::next> s{};
+        node nodes[count];
+        for (auto _ : state)
+        {
+            for (auto &n : nodes)
+            {
+                s.push(&n);
+            }
+            for (int i = 0; i != count; ++i)
+            {
+                bench::do_not_optimize(s.pop());
+            }
+        }
+    }
+    struct message
+    {
+        int value;
+        std::atomic<message *> next;
+    };
+    // mpsc_queueもnodeを確保しない
+    void mpsc_queue(bench::state &state)
+    {
+        lockfree::mpsc_queue<message, &message::next> q;
+        message messages[count]{};
+        for (auto _ : state)
+        {
+            for (auto &m : messages)
+            {
+                q.push(&m);
+            }
+            for (int i = 0; i != count; ++i)
+            {
+                bench::do_not_optimize(q.pop());
+            }
+        }
+    }
+    // 読み出し1回ごとにepochをannounceする。比較のため、atomicなポインタを読むだけのもの
+    void rcu_read(bench::state &state)
+    {
+        lockfree::rcu_cell<int> cell(1);
+        for (auto _ : state)
+        {
+            for (int i = 0; i != count; ++i)
+            {
+                bench::do_not_optimize(*cell.read());
+            }
+        }
+    }
+    void atomic_pointer_read(bench::state &state)
+    {
+        int value = 1;
+        std::atomic<int *> p{&value};
+        for (auto _ : state)
+        {
+            for (int i = 0; i != count; ++i)
+            {
+                bench::do_not_optimize(*p.load(std::memory_order_acquire));
+            }
+        }
+    }
+    void std_stack_mutex(bench::state &state)
+    {
+        std::stack<node *> s;
+        std::mutex m;
+        node nodes[count];
+        for (auto _ : state)
+        {
+            for (auto &n : nodes)
+            {
+                std::lock_guard lock(m);
+                s.push(&n);
+            }
+            for (int i = 0; i != count; ++i)
+            {
+                std::lock_guard lock(m);
+                bench::do_not_optimize(s.top());
+                s.pop();
+            }
+        }
+    }
+
+    // 上のキュー操作1回ごとにレイテンシを記録した場合に、記録自体がどれだけ足されるか
+    void histogram_record(bench::state &state)
+    {
+        static trace::histogram h;
+        std::uint64_t v = 0;
+        for (auto _ : state)
+        {
+            for (int i = 0; i != count; ++i)
+            {
+                h.record(v += 37);
+            }
+        }
+        bench::do_not_optimize(h);
+    }
+}
+
+BENCHMARK("lockfree::queue/enq_deq_64", lockfree_queue);
+BENCHMARK("lockfree::sharded_queue/enq_deq_64", sharded_queue);
+BENCHMARK("std::queue+mutex/push_pop_64", std_queue_mutex);
+BENCHMARK("atomic_recycling_stack/push_pop_64", lockfree_stack);
+BENCHMARK("lockfree::mpsc_queue/push_pop_64", mpsc_queue);
+BENCHMARK("lockfree::rcu_cell/read_64", rcu_read);
+BENCHMARK("std::atomic<T *>/load_64", atomic_pointer_read);
+BENCHMARK("std::stack+mutex/push_pop_64", std_stack_mutex);
+BENCHMARK("trace::histogram/record_64", histogram_record);
@@ -0,0 +1,123 @@
+#include <bench/benchmark.hpp>
+#include <basic/smart_pointer.hpp>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// basic/smart_pointer.hppのスマートポインタとstd::shared_ptr/std::unique_ptrの比較
+namespace
+{
+    using payload = std::pair<long, long>;
+
+    template <typename Ptr, typename Make>
+    void make(bench::state &state, Make make)
+    {
+        for (auto _ : state)
+        {
+            Ptr p = make();
+            bench::do_not_optimize(p.get());
+        }
+    }
+    void unique_ptr_make(bench::state &state)
+    {
+        make<unique_ptr<payload>>(state, []
+                                  { return make_unique<payload>(1, 2); });
+    }
+    void std_unique_ptr_make(bench::state &state)
+    {
+        make<std::unique_ptr<payload>>(state, []
+                                       { return std::make_unique<payload>(1, 2); });
+    }
+    // 破棄はreclaimerのスレッドに回すので、ここで計るのはキューに積むまで
+    void deferred_unique_ptr_make(bench::state &state)
+    {
+        make<unique_ptr<payload, deferred_delete<payload>>>(state, []
+                                                            { return unique_ptr<payload, deferred_delete<payload>>(new payload(1, 2)); });
+    }
+    void shared_ptr_make(bench::state &state)
+    {
+        make<shared_ptr<payload>>(state, []
+                                  { return make_shared<payload>(1, 2); });
+    }
+    void std_shared_ptr_make(bench::state &state)
+    {
+        make<std::shared_ptr<payload>>(state, []
+                                       { return std::make_shared<payload>(1, 2); });
+    }
+    void intrusive_ptr_make(bench::state &state)
+    {
+        struct node : intrusive_ref_counter<node>
+        {
+            long a = 1, b = 2;
+        };
+        make<intrusive_ptr<node>>(state, []
+                                  { return make_intrusive<node>(); });
+    }
+
+    // コピーと破棄で参照カウントを1回ずつ増減する
+    template <typename Ptr>
+    void copy(bench::state &state, const Ptr &p)
+    {
+        for (auto _ : state)
+        {
+            Ptr q = p;
+            bench::do_not_optimize(q.get());
+        }
+    }
+    void shared_ptr_copy(bench::state &state)
+    {
+        copy(state, make_shared<payload>(1, 2));
+    }
+    void local_shared_ptr_copy(bench::state &state)
+    {
+        copy(state, make_local_shared<payload>(1, 2));
+    }
+    void std_shared_ptr_copy(bench::state &state)
+    {
+        copy(state, std::make_shared<payload>(1, 2));
+    }
+    void intrusive_ptr_copy(bench::state &state)
+    {
+        struct node : intrusive_ref_counter<node>
+        {
+        };
+        copy(state, make_intrusive<node>());
+    }
+
+    void atomic_shared_ptr_load(bench::state &state)
+    {
+        atomic_shared_ptr<payload> a(make_shared<payload>(1, 2));
+        for (auto _ : state)
+        {
+            auto p = a.load();
+            bench::do_not_optimize(p.get());
+        }
+    }
+#if defined(__cpp_lib_atomic_shared_ptr)
+    void std_atomic_shared_ptr_load(bench::state &state)
+    {
+        std::atomic<std::shared_ptr<payload>> a(std::make_shared<payload>(1, 2));
+        for (auto _ : state)
+        {
+            auto p = a.load();
+            bench::do_not_optimize(p.get());
+        }
+    }
+#endif
+}
+
+BENCHMARK("unique_ptr/make_unique", unique_ptr_make);
+BENCHMARK("std::unique_ptr/make_unique", std_unique_ptr_make);
+BENCHMARK("unique_ptr<deferred_delete>/new", deferred_unique_ptr_make);
+BENCHMARK("shared_ptr/make_shared", shared_ptr_make);
+BENCHMARK("std::shared_ptr/make_shared", std_shared_ptr_make);
+BENCHMARK("intrusive_ptr/make_intrusive", intrusive_ptr_make);
+BENCHMARK("shared_ptr/copy", shared_ptr_copy);
+BENCHMARK("local_shared_ptr/copy", local_shared_ptr_copy);
+BENCHMARK("std::shared_ptr/copy", std_shared_ptr_copy);
+BENCHMARK("intrusive_ptr/copy", intrusive_ptr_copy);
+BENCHMARK("atomic_shared_ptr/load", atomic_shared_ptr_load);
+#if defined(__cpp_lib_atomic_shared_ptr)
+BENCHMARK("std::atomic<std::shared_ptr>/load", std_atomic_shared_ptr_load);
+#endif
@@ -0,0 +1,78 @@
+#include <bench/benchmark.hpp>
+#include <basic/my_vector.hpp>
+
+#include <numeric>
+#include <string>
+#include <vector>
+
+// basic/my_vector.hppのvectorとstd::vectorの比較
+namespace
+{
+    constexpr int count = 1000;
+
+    template <typename Vector>
+    void push_back(bench::state &state)
+    {
+        for (auto _ : state)
+        {
+            Vector v;
+            for (int i = 0; i != count; ++i)
+            {
+                v.push_back(i);
+            }
+            bench::do_not_optimize(v[0]);
+        }
+    }
+    template <typename Vector>
+    void reserve_push_back(bench::state &state)
+    {
+        for (auto _ : state)
+        {
+            Vector v;
+            v.reserve(count);
+            for (int i = 0; i != count; ++i)
+            {
+                v.push_back(i);
+            }
+            bench::do_not_optimize(v[0]);
+        }
+    }
+    template <typename Vector>
+    void push_back_string(bench::state &state)
+    {
+        const std::string s(32, 'x');
+        for (auto _ : state)
+        {
+            Vector v;
+            for (int i = 0; i != count; ++i)
+            {
+                v.push_back(s);
+            }
+            bench::do_not_optimize(v[0]);
+        }
+    }
+    template <typename Vector>
+    void iterate(bench::state &state)
+    {
+        Vector v;
+        for (int i = 0; i != count; ++i)
+        {
+            v.push_back(i);
+        }
+        for (auto _ : state)
+        {
+            bench::do_not_optimize(v);
+            auto sum = std::accumulate(v.begin(), v.end(), 0L);
+            bench::do_not_optimize(sum);
+        }
+    }
+}
+
+BENCHMARK("vector/push_back", push_back<vector<int>>);
+BENCHMARK("std::vector/push_back", push_back<std::vector<int>>);
+BENCHMARK("vector/reserve_push_back", reserve_push_back<vector<int>>);
+BENCHMARK("std::vector/reserve_push_back", reserve_push_back<std::vector<int>>);
+BENCHMARK("vector/push_back_string", push_back_string<vector<std::string>>);
+BENCHMARK("std::vector/push_back_string", push_back_string<std::vector<std::string>>);
+BENCHMARK("vector/iterate", iterate<vector<int>>);
+BENCHMARK("std::vector/iterate", iterate<std::vector<int>>);
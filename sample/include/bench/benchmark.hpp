@@ -0,0 +1,111 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// 外部ライブラリを使わない小さなマイクロベンチマーク
+// BENCHMARK("vector/push_back", fn) のように登録し、fnの中で for (auto _ : state) { ... } の形で計測したい処理を書く
+// ループの回数はランナーが決める(1回の計測がmin_timeを超えるまで増やす)
+namespace bench
+{
+    // コンパイラが計算結果を捨てて処理ごと消してしまわないようにする
+    // 値をレジスタかメモリに置いたことにして、それを読み出すasmがあるように見せかける
+    template <typename T>
+    inline void do_not_optimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+    template <typename T>
+    inline void do_not_optimize(T &value)
+    {
+        asm volatile("" : "+r,m"(value) : : "memory");
+    }
+    // それまでのメモリへの書き込みを、実際に行ったことにする
+    inline void clobber_memory()
+    {
+        asm volatile("" : : : "memory");
+    }
+
+    class state
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        explicit state(std::uint64_t iterations) : max_iterations(iterations) {}
+
+        // ループ変数は使わないが、自明なコンストラクタ・デストラクタを持つ型だとunused-but-set-variableの警告が出る
+        struct value
+        {
+            value() noexcept {}
+            ~value() {}
+        };
+        // for (auto _ : state) の1周が1 iteration。beginで計測を開始し、ループを抜けた時点で止める
+        class iterator
+        {
+            state *s;
+            std::uint64_t remaining;
+
+        public:
+            iterator(state *s, std::uint64_t remaining) : s(s), remaining(remaining) {}
+            value operator*() const noexcept { return {}; }
+            iterator &operator++() noexcept
+            {
+                --remaining;
+                return *this;
+            }
+            bool operator!=(const iterator &) const noexcept
+            {
+                if (remaining != 0)
+                {
+                    return true;
+                }
+                s->finish = clock::now();
+                return false;
+            }
+        };
+        iterator begin() noexcept
+        {
+            start = clock::now();
+            return {this, max_iterations};
+        }
+        iterator end() noexcept
+        {
+            return {this, 0};
+        }
+
+        // 準備や後始末を計測から外したい場合に、ループの中で囲む
+        void pause_timing() noexcept
+        {
+            paused_at = clock::now();
+        }
+        void resume_timing() noexcept
+        {
+            excluded += clock::now() - paused_at;
+        }
+
+        std::uint64_t iterations() const noexcept { return max_iterations; }
+        std::chrono::nanoseconds elapsed() const noexcept
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start - excluded);
+        }
+
+    private:
+        std::uint64_t max_iterations;
+        clock::time_point start{}, finish{}, paused_at{};
+        clock::duration excluded{};
+    };
+
+    using function = void (*)(state &);
+
+    // 静的初期化時に呼ばれる。登録順に実行される
+    bool register_benchmark(std::string name, function fn);
+}
+
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_(a, b)
+// fnにはpush_back<vector<int>>のように,を含むテンプレート引数を書けるよう可変長にしている
+#define BENCHMARK(name, ...) \
+    [[maybe_unused]] static const bool BENCHMARK_CONCAT(benchmark_registered_, __LINE__) = ::bench::register_benchmark(name, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include "histogram.hpp"
+
+int main()
+{
+    // どの値も自分のバケットの範囲に入り、バケットの幅は値の1/64以下
+    std::mt19937_64 rng(1);
+    bool ok = true;
+    for (int i = 0; i != 1000000; ++i)
+    {
+        auto v = rng() >> (rng() % 64);
+        auto b = trace::histogram::bucket_index(v);
+        auto lo = trace::histogram::bucket_lowest(b), hi = trace::histogram::bucket_highest(b);
+        ok = ok && b < trace::histogram::bucket_count && lo <= v && v <= hi && (hi - lo) <= v / 64;
+    }
+    std::cout << "buckets: " << trace::histogram::bucket_count << ' ' << sizeof(trace::histogram) << " bytes " << ok << std::endl;
+
+    // 4スレッドが1〜100000nsを一様に記録する。真の値はp50=50000, p99=99000, p99.9=99900
+    trace::concurrent_histogram latencies;
+    std::vector<std::thread> threads;
+    for (int t = 0; t != 4; ++t)
+    {
+        threads.emplace_back([&latencies, t]
+                             {
+                                 for (std::uint64_t v = 1 + t; v <= 100000; v += 4)
+                                 {
+                                     latencies.record(v);
+                                 } });
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    auto h = latencies.snapshot();
+    std::cout << "count: " << h.count() << " min: " << h.min() << " max: " << h.max() << " mean: " << h.mean() << std::endl;
+    std::cout << "p50: " << h.percentile(50) << " p99: " << h.percentile(99) << " p99.9: " << h.percentile(99.9) << std::endl;
+
+    // 送って受け取った側でmergeする
+    auto bytes = h.serialize();
+    auto restored = trace::histogram::deserialize(bytes);
+    restored.merge_serialized(bytes);
+    std::cout << "serialized: " << bytes.size() << " bytes " << (restored.count() == 2 * h.count()) << ' ' << (restored.percentile(99) == h.percentile(99)) << std::endl;
+    try
+    {
+        trace::histogram::deserialize(bytes.substr(0, bytes.size() - 1));
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cout << e.what() << std::endl;
+    }
+
+    // 1回の記録にかかる時間自体も記録してみる
+    trace::histogram cost;
+    trace::histogram sink;
+    for (int i = 0; i != 100000; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j != 100; ++j)
+        {
+            sink.record(static_cast<std::uint64_t>(i + j));
+        }
+        cost.record((std::chrono::steady_clock::now() - start) / 100);
+    }
+    std::cout << "record: p50 " << cost.percentile(50) << " ns p99 " << cost.percentile(99) << " ns" << std::endl;
+}
@@ -0,0 +1,353 @@
+#ifndef TRACE_HISTOGRAM_HPP
+#define TRACE_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// レイテンシ(ns)を記録するヒストグラム
+// HdrHistogramと同じlog-linearなバケット: 2のべきごとの区間を、さらにhalf個の等幅のバケットに分ける
+// * 値vの入るバケットは、vの最上位ビットの位置と、その下のsub_bits-1ビットだけで決まる(ループも除算もない)
+// * バケットの幅は値の1/64以下なので、percentileの誤差も1.6%以下
+// * 0からuint64_tの最大値までを、固定の3776バケット(約30KB)で表す。記録する値の数によって大きくならない
+// * recordはバケットのカウンタへのrelaxedなfetch_add 1回だけ。合計数や最大値は読み出す時にバケットから求める
+namespace trace
+{
+    class histogram
+    {
+    public:
+        static constexpr unsigned sub_bits = 7;
+        static constexpr std::size_t sub_count = std::size_t(1) << sub_bits;
+        static constexpr std::size_t half = sub_count / 2;
+        static constexpr std::size_t bucket_count = (64 - sub_bits + 2) * half;
+
+        histogram() = default;
+        // 記録中のhistogramからもコピーできる(その時点のスナップショットになる)
+        histogram(const histogram &r) noexcept
+        {
+            merge(r);
+        }
+        histogram &operator=(const histogram &r) noexcept
+        {
+            if (this != &r)
+            {
+                reset();
+                merge(r);
+            }
+            return *this;
+        }
+
+        static constexpr std::size_t bucket_index(std::uint64_t v) noexcept
+        {
+            // sub_count未満はそのまま、それ以上は上位sub_bitsビットを残すようにeビット右へずらす
+            unsigned msb = 63 - static_cast<unsigned>(std::countl_zero(v | 1));
+            unsigned e = msb < sub_bits ? 0 : msb - sub_bits + 1;
+            return e * half + static_cast<std::size_t>(v >> e);
+        }
+        // バケットに入る値の最小値と最大値
+        static constexpr std::uint64_t bucket_lowest(std::size_t i) noexcept
+        {
+            if (i < sub_count)
+            {
+                return i;
+            }
+            auto e = i / half - 1;
+            return static_cast<std::uint64_t>(i - e * half) << e;
+        }
+        static constexpr std::uint64_t bucket_highest(std::size_t i) noexcept
+        {
+            if (i < sub_count)
+            {
+                return i;
+            }
+            auto e = i / half - 1;
+            return bucket_lowest(i) + ((std::uint64_t(1) << e) - 1);
+        }
+
+        void record(std::uint64_t ns, std::uint64_t n = 1) noexcept
+        {
+            counts[bucket_index(ns)].fetch_add(n, std::memory_order_relaxed);
+        }
+        template <typename Rep, typename Period>
+        void record(std::chrono::duration<Rep, Period> d) noexcept
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+            record(ns < 0 ? 0 : static_cast<std::uint64_t>(ns));
+        }
+
+        // スレッドごとのhistogramを1つにまとめる
+        void merge(const histogram &r) noexcept
+        {
+            for (std::size_t i = 0; i != bucket_count; ++i)
+            {
+                auto n = r.counts[i].load(std::memory_order_relaxed);
+                if (n != 0)
+                {
+                    counts[i].fetch_add(n, std::memory_order_relaxed);
+                }
+            }
+        }
+        void reset() noexcept
+        {
+            for (auto &c : counts)
+            {
+                c.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        std::uint64_t count() const noexcept
+        {
+            std::uint64_t n = 0;
+            for (auto &c : counts)
+            {
+                n += c.load(std::memory_order_relaxed);
+            }
+            return n;
+        }
+        std::uint64_t bucket(std::size_t i) const noexcept
+        {
+            return counts[i].load(std::memory_order_relaxed);
+        }
+        // 記録がなければ0
+        std::uint64_t min() const noexcept
+        {
+            for (std::size_t i = 0; i != bucket_count; ++i)
+            {
+                if (bucket(i) != 0)
+                {
+                    return bucket_lowest(i);
+                }
+            }
+            return 0;
+        }
+        std::uint64_t max() const noexcept
+        {
+            for (std::size_t i = bucket_count; i != 0; --i)
+            {
+                if (bucket(i - 1) != 0)
+                {
+                    return bucket_highest(i - 1);
+                }
+            }
+            return 0;
+        }
+        // 各バケットの中央の値で近似した平均
+        double mean() const noexcept
+        {
+            double sum = 0;
+            std::uint64_t n = 0;
+            for (std::size_t i = 0; i != bucket_count; ++i)
+            {
+                auto c = bucket(i);
+                if (c != 0)
+                {
+                    sum += (static_cast<double>(bucket_lowest(i)) + static_cast<double>(bucket_highest(i))) / 2 * static_cast<double>(c);
+                    n += c;
+                }
+            }
+            return n == 0 ? 0 : sum / static_cast<double>(n);
+        }
+        // p(0〜100)パーセンタイルの値。そのバケットの最大値を返すので、真の値より小さくなることはない
+        std::uint64_t percentile(double p) const noexcept
+        {
+            auto total = count();
+            if (total == 0)
+            {
+                return 0;
+            }
+            p = std::clamp(p, 0.0, 100.0);
+            auto rank = static_cast<std::uint64_t>(p / 100 * static_cast<double>(total) + 0.5);
+            rank = std::clamp<std::uint64_t>(rank, 1, total);
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i != bucket_count; ++i)
+            {
+                seen += bucket(i);
+                if (seen >= rank)
+                {
+                    return bucket_highest(i);
+                }
+            }
+            return max();
+        }
+
+        // 空でないバケットだけを(前のバケットからの距離, カウント)の組として、LEB128の可変長整数で並べる
+        // 値の範囲が1桁程度に収まる分布なら数百byte、100000倍に広がっていても2KB程度
+        std::string serialize() const
+        {
+            std::string out;
+            out.push_back(format_version);
+            std::size_t prev = 0;
+            for (std::size_t i = 0; i != bucket_count; ++i)
+            {
+                auto c = bucket(i);
+                if (c != 0)
+                {
+                    put_varint(out, i - prev);
+                    put_varint(out, c);
+                    prev = i;
+                }
+            }
+            return out;
+        }
+        // serializeした結果を加える。別プロセスで記録したものともmergeできる
+        void merge_serialized(std::string_view in)
+        {
+            if (in.empty() || in.front() != format_version)
+            {
+                throw std::invalid_argument("histogram: unknown format");
+            }
+            in.remove_prefix(1);
+            // 壊れた入力の一部だけが加わらないよう、全て読めてから加える
+            std::vector<std::pair<std::size_t, std::uint64_t>> parsed;
+            std::size_t i = 0;
+            while (!in.empty())
+            {
+                i += static_cast<std::size_t>(get_varint(in));
+                auto c = get_varint(in);
+                if (i >= bucket_count)
+                {
+                    throw std::invalid_argument("histogram: bucket index is out of range");
+                }
+                parsed.emplace_back(i, c);
+            }
+            for (auto [index, c] : parsed)
+            {
+                counts[index].fetch_add(c, std::memory_order_relaxed);
+            }
+        }
+        static histogram deserialize(std::string_view in)
+        {
+            histogram h;
+            h.merge_serialized(in);
+            return h;
+        }
+
+        // スコープの経過時間を記録する
+        class timer
+        {
+            histogram &h;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        public:
+            explicit timer(histogram &h) noexcept : h(h) {}
+            ~timer()
+            {
+                h.record(std::chrono::steady_clock::now() - start);
+            }
+            timer(const timer &) = delete;
+            timer &operator=(const timer &) = delete;
+        };
+
+    private:
+        static constexpr char format_version = 1;
+
+        std::atomic<std::uint64_t> counts[bucket_count]{};
+
+        static void put_varint(std::string &out, std::uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                out.push_back(static_cast<char>(v | 0x80));
+                v >>= 7;
+            }
+            out.push_back(static_cast<char>(v));
+        }
+        static std::uint64_t get_varint(std::string_view &in)
+        {
+            std::uint64_t v = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7)
+            {
+                if (in.empty())
+                {
+                    throw std::invalid_argument("histogram: truncated input");
+                }
+                auto b = static_cast<unsigned char>(in.front());
+                in.remove_prefix(1);
+                v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+                if ((b & 0x80) == 0)
+                {
+                    return v;
+                }
+            }
+            throw std::invalid_argument("histogram: varint is too long");
+        }
+    };
+
+    // 複数のスレッドから記録するためのhistogramの組
+    // 1つのhistogramを全スレッドで共有すると、よく当たるバケットのカウンタ(キャッシュライン)を取り合う
+    // スレッドごとに別のhistogramへ記録し、読み出す時にsnapshotでまとめる
+    // スレッドの数がshardsより多ければ共有するスレッドも出るが、カウンタはatomicなので数え落としはない
+    class concurrent_histogram
+    {
+    public:
+        explicit concurrent_histogram(std::size_t shards = default_shards())
+            : num_shards(shards == 0 ? 1 : shards), shards(std::make_unique<shard[]>(num_shards))
+        {
+        }
+
+        static std::size_t default_shards()
+        {
+            auto n = std::thread::hardware_concurrency();
+            return n == 0 ? 1 : n;
+        }
+
+        histogram &local() noexcept
+        {
+            return shards[thread_slot() % num_shards].h;
+        }
+        void record(std::uint64_t ns) noexcept
+        {
+            local().record(ns);
+        }
+        template <typename Rep, typename Period>
+        void record(std::chrono::duration<Rep, Period> d) noexcept
+        {
+            local().record(d);
+        }
+
+        histogram snapshot() const noexcept
+        {
+            histogram h;
+            for (std::size_t i = 0; i != num_shards; ++i)
+            {
+                h.merge(shards[i].h);
+            }
+            return h;
+        }
+        void reset() noexcept
+        {
+            for (std::size_t i = 0; i != num_shards; ++i)
+            {
+                shards[i].h.reset();
+            }
+        }
+
+    private:
+        struct alignas(64) shard
+        {
+            histogram h;
+        };
+
+        std::size_t num_shards;
+        std::unique_ptr<shard[]> shards;
+
+        static std::size_t thread_slot()
+        {
+            static std::atomic<std::size_t> next{0};
+            thread_local std::size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+            return slot;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,106 @@
+// TRACE_ENABLEDを定義しないとトレースは全て消えるので、このデモは定義してビルドする
+//   clang++ -std=c++20 -O2 -DTRACE_ENABLED -pthread trace/trace.cpp -latomic
+// 出力したJSONはchrome://tracing か https://ui.perfetto.dev で開ける
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED
+#endif
+#include <iostream>
+#include <time.h> // clock_gettime
+#include "trace.hpp"
+#include "../basic/my_vector.hpp"
+#include "../lockfree/queue.hpp"
+#include "../lockfree/stack.hpp"
+
+// このスレッドが使ったCPU時間。コア数が少ないとコレクタスレッドの時間が経過時間に混ざるので、こちらで測る
+long long thread_cpu_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// 1イベントあたりのコストを測る。リングがいっぱいにならないよう、容量の半分ずつ記録してはコレクタを待つ
+double nanoseconds_per_event()
+{
+    constexpr int burst = trace::ring::capacity / 2;
+    long long total = 0;
+    for (int round = 0; round != 20; ++round)
+    {
+        auto start = thread_cpu_ns();
+        for (int i = 0; i != burst; ++i)
+        {
+            TRACE_SCOPE("empty");
+        }
+        total += thread_cpu_ns() - start;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return static_cast<double>(total) / (20.0 * burst);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "trace.json";
+    {
+        trace::session session(path);
+
+        lockfree::queue<int> que;
+        std::vector<std::thread> threads;
+        for (int t = 0; t != 2; ++t)
+        {
+            threads.emplace_back([&que]
+                                 {
+                                     for (int i = 0; i != 1000; ++i)
+                                     {
+                                         que.enq(i);
+                                     } });
+        }
+        threads.emplace_back([&que]
+                             {
+                                 long sum = 0;
+                                 for (int i = 0; i != 2000; ++i)
+                                 {
+                                     sum += que.deq();
+                                 }
+                                 std::cout << "sum: " << sum << std::endl; });
+
+        struct person
+        {
+            int id;
+            person *next;
+        };
+        threads.emplace_back([]
+                             {
+                                 atomic_recycling_stack<person, &person::next> stack{};
+                                 person people[100]{};
+                                 for (auto &p : people)
+                                 {
+                                     stack.push(&p);
+                                 }
+                                 while (stack.pop() != nullptr)
+                                 {
+                                 } });
+        threads.emplace_back([]
+                             {
+                                 vector<int> v;
+                                 for (int i = 0; i != 100000; ++i)
+                                 {
+                                     v.push_back(i);
+                                 } });
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+
+        std::cout << "enabled: " << nanoseconds_per_event() << " ns/event" << std::endl;
+        // コレクタが書き出すのを待つ
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::cout << "written: " << session.events_written() << " dropped: " << trace::session::events_dropped() << std::endl;
+    }
+    // sessionがない間は時刻も取らない
+    auto start = thread_cpu_ns();
+    for (int i = 0; i != 1000000; ++i)
+    {
+        TRACE_SCOPE("disabled");
+    }
+    std::cout << "disabled: " << static_cast<double>(thread_cpu_ns() - start) / 1e6 << " ns/event" << std::endl;
+}
@@ -0,0 +1,335 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+// ホットパス用のトレース
+// TRACE_SCOPE("lockfree::queue::enq") と書いたスコープの開始・終了時刻を記録し、Chrome/Perfettoで読めるJSONに書き出す
+// * TRACE_ENABLEDを定義してビルドした場合だけ有効。定義しなければTRACE_SCOPEは何も生成しない(コストは0)
+// * 時刻はrdtsc(x86以外ではsteady_clock)。1イベントは、rdtsc 2回とスレッドごとのリングバッファへの書き込み1回
+// * リングバッファは書き込むスレッドが1つ、読み出すのがコレクタスレッド1つのSPSCなので、ロックもCASも不要
+//   いっぱいの時はイベントを捨てて数えるだけで、書き込む側を待たせることはない
+// * trace::sessionを作るとコレクタスレッドが起動し、定期的に全スレッドのバッファを読み出してファイルに書く
+//   sessionがない間はイベントを記録しない
+#if defined(TRACE_ENABLED)
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace trace
+{
+    inline std::uint64_t now() noexcept
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // 名前は文字列リテラルを想定し、ポインタだけを持つ
+    struct event
+    {
+        const char *name;
+        std::uint64_t begin;
+        std::uint64_t end;
+    };
+
+    // 1スレッド分のリングバッファ
+    // headは書き込むスレッドだけが、tailはコレクタだけが進める。それぞれ別のキャッシュラインに置く
+    class ring
+    {
+    public:
+        static constexpr std::size_t capacity = 1 << 13;
+        static_assert((capacity & (capacity - 1)) == 0);
+
+        explicit ring(std::uint32_t tid) : tid(tid) {}
+
+        void push(const event &e) noexcept
+        {
+            auto h = head.load(std::memory_order_relaxed);
+            // tailを毎回読むとコレクタとキャッシュラインを取り合うので、いっぱいに見えた時だけ読み直す
+            if (h - cached_tail == capacity)
+            {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (h - cached_tail == capacity)
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            events[h & (capacity - 1)] = e;
+            head.store(h + 1, std::memory_order_release);
+        }
+        // コレクタから呼ぶ
+        template <typename F>
+        void drain(F f)
+        {
+            auto t = tail.load(std::memory_order_relaxed);
+            auto h = head.load(std::memory_order_acquire);
+            for (; t != h; ++t)
+            {
+                f(events[t & (capacity - 1)]);
+            }
+            tail.store(t, std::memory_order_release);
+        }
+        bool empty() const noexcept
+        {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+        std::uint32_t tid;
+        // スレッドが終了したらfalse。空になったリングは次に作られたスレッドが使い回す
+        std::atomic<bool> alive{true};
+        std::atomic<std::uint64_t> dropped{0};
+
+    private:
+        alignas(64) std::atomic<std::uint64_t> head{0};
+        std::uint64_t cached_tail = 0;
+        alignas(64) std::atomic<std::uint64_t> tail{0};
+        alignas(64) event events[capacity];
+    };
+
+    class registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ring>> rings;
+        std::uint32_t next_tid = 1;
+
+    public:
+        static registry &instance()
+        {
+            static registry r;
+            return r;
+        }
+
+        ring *acquire()
+        {
+            std::lock_guard lock(mutex);
+            for (auto &r : rings)
+            {
+                if (!r->alive.load(std::memory_order_acquire) && r->empty())
+                {
+                    r->tid = next_tid++;
+                    r->alive.store(true, std::memory_order_release);
+                    return r.get();
+                }
+            }
+            rings.push_back(std::make_unique<ring>(next_tid++));
+            return rings.back().get();
+        }
+        template <typename F>
+        void for_each(F f)
+        {
+            std::lock_guard lock(mutex);
+            for (auto &r : rings)
+            {
+                f(*r);
+            }
+        }
+    };
+
+    // sessionがある間だけtrue
+    inline std::atomic<bool> enabled{false};
+
+    // スレッドごとのリング。最初にイベントを記録した時に割り当て、スレッドの終了時に返す
+    // デストラクタを持つthread_localは参照するたびに初期化済みかの確認が入るので、
+    // 毎回読むポインタ(local_ring)と、終了時に返すためのオブジェクト(thread_ring)を分けている
+    inline thread_local ring *local_ring = nullptr;
+
+    class thread_ring
+    {
+        ring *r;
+
+    public:
+        thread_ring() : r(registry::instance().acquire()) {}
+        ~thread_ring()
+        {
+            local_ring = nullptr;
+            r->alive.store(false, std::memory_order_release);
+        }
+        ring *get() const noexcept { return r; }
+    };
+    [[gnu::noinline]] inline ring *attach_ring()
+    {
+        thread_local thread_ring owner;
+        return local_ring = owner.get();
+    }
+    inline ring &current_ring()
+    {
+        auto r = local_ring;
+        if (r == nullptr) [[unlikely]]
+        {
+            r = attach_ring();
+        }
+        return *r;
+    }
+
+    class scope
+    {
+        const char *name = nullptr;
+        std::uint64_t begin = 0;
+
+    public:
+        // sessionがなければ時刻も取らない
+        explicit scope(const char *name) noexcept
+        {
+            if (enabled.load(std::memory_order_relaxed))
+            {
+                this->name = name;
+                begin = now();
+            }
+        }
+        ~scope()
+        {
+            if (name != nullptr)
+            {
+                current_ring().push({name, begin, now()});
+            }
+        }
+        scope(const scope &) = delete;
+        scope &operator=(const scope &) = delete;
+    };
+
+    // コレクタスレッドを動かし、Chrome trace event format(JSON)でファイルに書き出す
+    // https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+    // 同時に作れるsessionは1つ
+    class session
+    {
+        std::ofstream out;
+        std::chrono::milliseconds interval;
+        std::atomic<bool> stop{false};
+        std::uint64_t tsc_origin;
+        double ns_per_tick = 1;
+        std::atomic<std::uint64_t> written{0};
+        std::thread collector;
+
+        // rdtscの1tickが何nsかを測る
+        void calibrate()
+        {
+            auto c0 = std::chrono::steady_clock::now();
+            auto t0 = now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            auto c1 = std::chrono::steady_clock::now();
+            auto t1 = now();
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(c1 - c0).count();
+            if (t1 > t0)
+            {
+                ns_per_tick = static_cast<double>(ns) / static_cast<double>(t1 - t0);
+            }
+        }
+        std::int64_t to_ns(std::uint64_t t) const noexcept
+        {
+            return static_cast<std::int64_t>(static_cast<double>(static_cast<std::int64_t>(t - tsc_origin)) * ns_per_tick);
+        }
+        // ts, durはマイクロ秒。小数点以下3桁でns単位まで残す
+        // 1イベントごとにiostreamで浮動小数点数を書くとコレクタが追いつかないので、to_charsで整数として書く
+        static char *put_us(char *p, char *last, std::int64_t ns) noexcept
+        {
+            if (ns < 0)
+            {
+                *p++ = '-';
+                ns = -ns;
+            }
+            p = std::to_chars(p, last, ns / 1000).ptr;
+            *p++ = '.';
+            auto frac = ns % 1000;
+            *p++ = static_cast<char>('0' + frac / 100);
+            *p++ = static_cast<char>('0' + frac / 10 % 10);
+            *p++ = static_cast<char>('0' + frac % 10);
+            return p;
+        }
+        void write(const ring &r, const event &e)
+        {
+            char buf[128];
+            char *p = buf, *last = buf + sizeof(buf);
+            p = std::to_chars(p, last, r.tid).ptr;
+            p = std::strcpy(p, ",\"ts\":") + 6;
+            auto begin = to_ns(e.begin);
+            p = put_us(p, last, begin);
+            p = std::strcpy(p, ",\"dur\":") + 7;
+            p = put_us(p, last, to_ns(e.end) - begin);
+            out << (written.load(std::memory_order_relaxed) == 0 ? "\n" : ",\n")
+                << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            out.write(buf, p - buf);
+            out << '}';
+            written.fetch_add(1, std::memory_order_relaxed);
+        }
+        void collect()
+        {
+            registry::instance().for_each([this](ring &r)
+                                          { r.drain([&](const event &e)
+                                                    { write(r, e); }); });
+        }
+        void run()
+        {
+            while (!stop.load(std::memory_order_acquire))
+            {
+                collect();
+                std::this_thread::sleep_for(interval);
+            }
+            collect();
+        }
+
+    public:
+        explicit session(const std::string &path, std::chrono::milliseconds interval = std::chrono::milliseconds(1))
+            : out(path), interval(interval), tsc_origin(now())
+        {
+            if (!out)
+            {
+                throw std::runtime_error("trace: cannot open " + path);
+            }
+            calibrate();
+            out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+            collector = std::thread([this]
+                                    { run(); });
+            enabled.store(true, std::memory_order_release);
+        }
+        ~session()
+        {
+            enabled.store(false, std::memory_order_release);
+            stop.store(true, std::memory_order_release);
+            collector.join();
+            out << "\n]}\n";
+        }
+        session(const session &) = delete;
+        session &operator=(const session &) = delete;
+
+        // ここまでにファイルへ書き出したイベント数
+        std::uint64_t events_written() const noexcept
+        {
+            return written.load(std::memory_order_relaxed);
+        }
+        // リングがいっぱいで捨てたイベント数(全スレッドの合計)
+        static std::uint64_t events_dropped()
+        {
+            std::uint64_t n = 0;
+            registry::instance().for_each([&n](ring &r)
+                                          { n += r.dropped.load(std::memory_order_relaxed); });
+            return n;
+        }
+    };
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) ::trace::scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) static_cast<void>(0)
+
+#endif
+
+#endif